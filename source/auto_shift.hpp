@@ -0,0 +1,72 @@
+/********************************************************************************
+ * File: auto_shift.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Delayed auto-shift for the Tetris Overlay's held buttons. A press moves
+ *   the piece once; after the delay (DAS) it repeats every repeat interval
+ *   (ARR). Each poll reports how many steps fell due since the previous
+ *   one, counted from the exact times they were due rather than from when
+ *   the poll happened, so the repeat rate does not depend on the overlay's
+ *   frame rate and the caller can apply the steps as one batched move. An
+ *   interval of zero means instant: every step the piece can take.
+ *
+ *   Soft drop uses the same component with no separate delay and an
+ *   interval of the gravity interval divided by the soft-drop factor.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <climits>
+
+constexpr int AUTO_SHIFT_INSTANT = INT_MAX; // Steps owed when the interval is zero: as many as fit
+
+struct AutoShiftTiming {
+    int delayMs;   // From the press to the first repeat
+    int repeatMs;  // Between repeats; 0 is instant
+};
+
+struct AutoShift {
+    using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+
+    bool held = false;       // Down at the previous poll
+    bool repeating = false;  // The delay has run out
+    TimePoint last{};        // The press, or the last step that fell due
+
+    // Steps owed at now for a button that is down (or not); the first press owes one
+    int poll(bool down, TimePoint now, AutoShiftTiming timing) {
+        if (!down) {
+            held = false;
+            return 0;
+        }
+        if (!held) {
+            held = true;
+            repeating = false;
+            last = now;
+            return 1;
+        }
+
+        int steps = 0;
+        if (!repeating) {
+            if (now - last < std::chrono::milliseconds(timing.delayMs)) return 0;
+            repeating = true;
+            last += std::chrono::milliseconds(timing.delayMs);
+            steps = 1;
+        }
+        if (timing.repeatMs <= 0) return AUTO_SHIFT_INSTANT;
+
+        auto due = std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count() / timing.repeatMs;
+        last += std::chrono::milliseconds(due * timing.repeatMs);
+        return steps + static_cast<int>(due);
+    }
+
+    // Keep the button charging from now without stepping, e.g. while the opposite direction has priority
+    void suspend(TimePoint now) {
+        held = true;
+        repeating = false;
+        last = now;
+    }
+};
@@ -0,0 +1,98 @@
+/********************************************************************************
+ * File: autoplay.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Turns a search result into the button frames a player would press, so
+ *   the autoplay bot drives the game through the same input handling (and
+ *   replay recording) as a human. Every press carries the piece position it
+ *   expects to find; the caller replans when the live game disagrees, for
+ *   example after gravity moved the piece.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "beam_search.hpp"
+#include "bitboard.hpp"
+#include "move_generator.hpp"
+#include "replay.hpp"
+
+// One input frame of a plan: buttons pressed (and held) for exactly that frame
+struct AutoplayFrame {
+    uint8_t buttons = 0;   // ReplayButton mask, 0 for a release frame
+    int8_t x = 0, y = 0;   // Piece position expected before the press
+    uint8_t rotation = 0;
+};
+
+// Expand move into frames starting from situation; false if the path does not
+// reproduce the placement on this board
+inline bool buildAutoplayPlan(const SearchSituation& situation, const SearchMove& move, std::vector<AutoplayFrame>& frames) {
+    frames.clear();
+    if (!move.found) return false;
+
+    const Bitboard& board = situation.board;
+    Tetrimino piece = situation.current;
+    uint8_t lastButton = 0;
+
+    // Shifts and soft drops only repeat on a fresh press, so the same button needs a release in between
+    auto press = [&](uint8_t button) {
+        if (button == lastButton && (button & (REPLAY_LEFT | REPLAY_RIGHT | REPLAY_DOWN))) {
+            frames.push_back({0, int8_t(piece.x), int8_t(piece.y), uint8_t(piece.rotation)});
+        }
+        frames.push_back({button, int8_t(piece.x), int8_t(piece.y), uint8_t(piece.rotation)});
+        lastButton = button;
+    };
+    auto shift = [&](int dx, uint8_t button) {
+        if (!board.fits(piece.type, piece.rotation, piece.x + dx, piece.y)) return false;
+        press(button);
+        piece.x += dx;
+        return true;
+    };
+    auto drop = [&]() {
+        if (!board.fits(piece.type, piece.rotation, piece.x, piece.y + 1)) return false;
+        press(REPLAY_DOWN); // Never pressed on the floor, where a soft drop locks the piece
+        piece.y += 1;
+        return true;
+    };
+
+    if (move.useHold) {
+        press(REPLAY_L);
+        piece = holdStartPiece(situation);
+    }
+    if (piece.type != move.type) return false;
+
+    const Placement& placement = move.placement;
+    for (size_t i = 0; i < placement.pathLength; ++i) {
+        switch (placement.path[i]) {
+            case MOVE_LEFT:       if (!shift(-1, REPLAY_LEFT)) return false; break;
+            case MOVE_RIGHT:      if (!shift(1, REPLAY_RIGHT)) return false; break;
+            case MOVE_SOFT_DROP:  if (!drop()) return false; break;
+            case MOVE_DAS_LEFT:   while (shift(-1, REPLAY_LEFT)) {} break;
+            case MOVE_DAS_RIGHT:  while (shift(1, REPLAY_RIGHT)) {} break;
+            case MOVE_SONIC_DROP: while (drop()) {} break;
+            case MOVE_ROTATE_CW:
+            case MOVE_ROTATE_CCW: {
+                int direction = (placement.path[i] == MOVE_ROTATE_CW) ? -1 : 1;
+                RotationResult turn = tryRotate(board, piece.type, piece.x, piece.y, piece.rotation, direction);
+                if (!turn.success) return false;
+                press(direction < 0 ? REPLAY_A : REPLAY_B);
+                piece.x = turn.x;
+                piece.y = turn.y;
+                piece.rotation = turn.rotation;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // The hard drop has to land exactly on the searched placement
+    press(REPLAY_UP);
+    int landing = piece.y + board.dropDistance(piece.type, piece.rotation, piece.x, piece.y);
+    return piece.x == placement.x && landing == placement.y && piece.rotation == placement.rotation;
+}
@@ -0,0 +1,457 @@
+/********************************************************************************
+ * File: beam_search.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Best-placement search for the Tetris Overlay's hint and autoplay modes.
+ *   BeamSearch places the active piece and then each piece of the preview
+ *   queue in turn, with or without a swap through the hold slot, and keeps
+ *   only the best beamWidth boards at every depth. Nodes are bitboard
+ *   copies stored in a SearchArena that is rewound per search, so expanding
+ *   thousands of placements does no allocation. The beam width adapts to
+ *   the time budget between searches.
+ *
+ *   A transposition table keyed by Zobrist hashes serves two purposes. A
+ *   board reached again at the same depth by another move order, with the
+ *   same hold slot and queue position, is dropped instead of taking a
+ *   second beam slot. Board evaluations are cached across searches until
+ *   the weights change.
+ *
+ *   With expectimax enabled, the boards of the deepest level are scored by
+ *   their expected value over the unknown piece after the queue: the
+ *   average, over every type that can still come, of the best placement of
+ *   that piece or of the held one, over the types the game's randomizer
+ *   can deal next (SearchSituation::nextPieces). Expected values go into
+ *   the same table, keyed by that set.
+ *
+ *   Given a ThreadPool, the subtrees below the boards of a level and the
+ *   expected values of the deepest boards are computed as separate tasks.
+ *   Each pool thread fills its own beam with its own move generator, and
+ *   the beams are merged once the level is done; the transposition table
+ *   is shared without locks.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include "bitboard.hpp"
+#include "evaluator.hpp"
+#include "move_generator.hpp"
+#include "search_arena.hpp"
+#include "thread_pool.hpp"
+#include "transposition_table.hpp"
+#include "zobrist.hpp"
+
+constexpr size_t SEARCH_PREVIEW_SIZE = 3;
+
+// Everything the search needs to know, copied out of the game
+struct SearchSituation {
+    Bitboard board;
+    Tetrimino current{0};
+    int stored = -1;       // Type in the hold slot, -1 when empty
+    bool canHold = true;   // False once hold was used for this piece
+    std::array<int8_t, SEARCH_PREVIEW_SIZE> preview{};
+    uint8_t nextPieces = ALL_PIECE_TYPES; // Types that can follow the preview, equally likely: PieceRandomizer::possibleNext()
+};
+
+struct SearchMove {
+    bool found = false;
+    bool useHold = false;  // Press hold first, then play placement with the swapped-in piece
+    int type = -1;         // Piece that lands at placement
+    Placement placement;
+    float score = 0.0f;
+    bool perfectClear = false; // First placement of a perfect clear found by PerfectClearSolver
+};
+
+// The piece that becomes active after pressing hold, where swapStoredTetrimino puts it
+inline Tetrimino holdStartPiece(const SearchSituation& situation) {
+    if (situation.stored >= 0) return Tetrimino(situation.stored);
+
+    // Holding into an empty slot spawns the next piece instead
+    Tetrimino piece(situation.preview[0]);
+    placeAtSpawn(piece);
+    return piece;
+}
+
+// Work counters of the last search
+struct BeamSearchStats {
+    size_t expansions = 0;   // Move generator runs
+    size_t children = 0;     // Placements scored
+    size_t duplicates = 0;   // Placements dropped as transpositions
+    size_t cachedEvals = 0;  // Evaluations answered by the table
+    size_t chanceNodes = 0;  // Boards scored by expected value
+};
+
+class BeamSearch {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int MIN_BEAM_WIDTH = 4;
+    // Transposition table slots, 16 bytes each: 64 KB from the overlay's small heap on the
+    // console, 512 KB for the host tools
+    static constexpr size_t CONSOLE_TABLE_SLOTS = size_t(1) << 12;
+    static constexpr size_t HOST_TABLE_SLOTS = size_t(1) << 15;
+
+    explicit BeamSearch(size_t tableSlots = CONSOLE_TABLE_SLOTS) : table(tableSlots) {}
+
+    EvalWeights weights;
+    int maxDepth = SEARCH_PREVIEW_SIZE + 1; // Pieces placed along a line: the active one and the preview
+    int beamWidth = 16;                     // Boards kept per depth
+    int maxBeamWidth = 64;
+    bool adaptiveWidth = true;              // Widen while searches finish early, narrow when they run out
+    bool expectimax = true;                 // Average the deepest boards over the next unknown piece
+    ThreadPool* pool = nullptr;             // Spreads each level over the pool; nullptr searches on the calling thread
+    BeamSearchStats stats;
+
+    // Best first move of the best line found before deadline, or nothing once cancelled() turns true
+    template <typename CancelCheck>
+    SearchMove run(const SearchSituation& situation, Clock::time_point deadline, CancelCheck cancelled) {
+        const auto start = Clock::now();
+        const int width = std::clamp(beamWidth, MIN_BEAM_WIDTH, maxBeamWidth);
+        const size_t laneCount = pool ? pool->concurrency() : 1;
+
+        // Cached evaluations are only valid for the weights that produced them
+        if (!(weights == tableWeights)) {
+            table.clear();
+            tableWeights = weights;
+        }
+        ++searchCount;
+
+        if (laneCount > lanesAllocated) {
+            lanes.reset(new Lane[laneCount]);
+            lanesAllocated = laneCount;
+        }
+        arena.reset(SearchArena::bytesFor<SearchMove>(ROOT_MOVE_LIMIT) + (laneCount + 2) * SearchArena::bytesFor<Node>(width)
+                    + SearchArena::bytesFor<float>(width));
+        rootMoves = arena.allocate<SearchMove>(ROOT_MOVE_LIMIT);
+        rootMoveCount = 0;
+        Node* level = arena.allocate<Node>(width);
+        Node* nextLevel = arena.allocate<Node>(width);
+        float* expected = arena.allocate<float>(width);
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            lanes[lane].beam = {arena.allocate<Node>(width), 0, size_t(width)};
+            lanes[lane].stats = BeamSearchStats();
+        }
+
+        // The known queue: the active piece, then the preview up to the first unknown entry
+        queueLength = 1;
+        queue[0] = static_cast<int8_t>(situation.current.type);
+        for (int8_t type : situation.preview) {
+            if (type < 0) break;
+            queue[queueLength++] = type;
+        }
+
+        // Depth one: the active piece as it stands, or whatever hold swaps in
+        Node root;
+        root.board = EvalBoard::fromBitboard(situation.board);
+        root.stored = static_cast<int8_t>(situation.stored);
+        levelStamp = stampFor(1);
+
+        Lane& first = lanes[0];
+        expand(first, root, situation.current, false, 1, root.stored, true);
+        if (situation.canHold && (situation.stored >= 0 || queueLength > 1)) {
+            expand(first, root, holdStartPiece(situation), true, (situation.stored >= 0) ? 1 : 2, queue[0], true);
+        }
+        size_t levelSize = mergeLanes(laneCount, level, width);
+        if (levelSize == 0) {
+            collectStats(laneCount);
+            return SearchMove();
+        }
+
+        SearchMove best = finishLevel(level, levelSize);
+        bool ranOut = false;
+
+        for (int depth = 2; depth <= maxDepth; ++depth) {
+            levelStamp = stampFor(depth);
+            bool finished = forEachTask(levelSize, deadline, cancelled, [this, level](Lane& lane, size_t i) {
+                expandChildren(lane, level[i]);
+            });
+            size_t nextSize = mergeLanes(laneCount, nextLevel, width);
+            if (!finished) {
+                if (cancelled()) return SearchMove();
+                ranOut = true;
+                break;
+            }
+            if (nextSize == 0) break;
+
+            best = finishLevel(nextLevel, nextSize);
+            levelSize = nextSize;
+            std::swap(level, nextLevel);
+        }
+
+        if (expectimax && !ranOut) {
+            uint8_t nextPieces = situation.nextPieces;
+            for (size_t i = 0; i < levelSize; ++i) expected[i] = NAN;
+            ranOut = !forEachTask(levelSize, deadline, cancelled, [this, level, expected, nextPieces](Lane& lane, size_t i) {
+                const Node& node = level[i];
+                if (node.board.toppedOut) return;
+                uint8_t pieces = (node.next < queueLength) ? uint8_t(1u << queue[node.next]) : nextPieces;
+                expected[i] = node.reward + expectedValue(lane, node, pieces);
+            });
+            if (cancelled()) return SearchMove();
+
+            // Should the deadline cut this short, only boards that were fully averaged compete
+            const float* top = nullptr;
+            for (size_t i = 0; i < levelSize; ++i) {
+                if (!std::isnan(expected[i]) && (!top || expected[i] > *top)) top = &expected[i];
+            }
+            if (top) {
+                best = rootMoves[level[top - expected].root];
+                best.score = *top;
+            }
+        }
+
+        collectStats(laneCount);
+        if (adaptiveWidth) adaptWidth(width, ranOut, Clock::now() - start, deadline - start);
+        return best;
+    }
+
+private:
+    static constexpr size_t ROOT_MOVE_LIMIT = 2 * MOVE_MAX_PLACEMENTS;
+
+    struct Node {
+        EvalBoard board;
+        float reward = 0.0f;  // Clear rewards collected along the line
+        float score = 0.0f;   // reward plus the evaluation of board
+        int16_t root = -1;    // Index into rootMoves of the line's first move
+        int8_t next = 1;      // Queue index of the next piece to place
+        int8_t stored = -1;   // Hold slot after this line
+    };
+
+    // Best boards of a level so far, kept as a min-heap on score while it fills
+    struct Beam {
+        Node* nodes = nullptr;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    // Scratch space of one pool thread
+    struct Lane {
+        MoveGenerator generator;
+        Beam beam;
+        BeamSearchStats stats;
+    };
+
+    std::unique_ptr<Lane[]> lanes;
+    size_t lanesAllocated = 0;
+    SearchArena arena;
+    TranspositionTable table;
+    EvalWeights tableWeights;
+    uint32_t searchCount = 0;
+    uint32_t levelStamp = 0;    // Marks node entries written for the level being filled
+    SearchMove* rootMoves = nullptr;
+    size_t rootMoveCount = 0;
+    std::array<int8_t, SEARCH_PREVIEW_SIZE + 1> queue{};
+    int queueLength = 0;
+
+    static bool betterScore(const Node& a, const Node& b) { return a.score > b.score; }
+
+    uint32_t stampFor(int depth) const { return (searchCount << 4) | uint32_t(depth); }
+
+    // Run work(lane, i) for every i below count, on the pool when there is one. Returns
+    // false if cancelled() or the deadline stopped it before every index was done.
+    template <typename CancelCheck, typename Work>
+    bool forEachTask(size_t count, Clock::time_point deadline, CancelCheck& cancelled, Work work) {
+        if (!pool || pool->concurrency() == 1) {
+            for (size_t i = 0; i < count; ++i) {
+                if (cancelled() || Clock::now() >= deadline) return false;
+                work(lanes[0], i);
+            }
+            return true;
+        }
+
+        TaskGroup group;
+        auto task = [&](size_t i) {
+            if (group.token.cancelled()) return;
+            if (cancelled() || Clock::now() >= deadline) {
+                group.token.cancel();
+                return;
+            }
+            work(lanes[ThreadPool::currentLane()], i);
+        };
+        pool->submitEach(group, count, task);
+        pool->wait(group);
+        return !group.token.cancelled();
+    }
+
+    // Merge the beams every lane filled into nodes, keeping the best width; returns the count
+    size_t mergeLanes(size_t laneCount, Node* nodes, size_t width) {
+        Beam merged{nodes, 0, width};
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            Beam& beam = lanes[lane].beam;
+            for (size_t i = 0; i < beam.size; ++i) offer(merged, beam.nodes[i]);
+            beam.size = 0;
+        }
+        return merged.size;
+    }
+
+    void collectStats(size_t laneCount) {
+        stats = BeamSearchStats();
+        for (size_t lane = 0; lane < laneCount; ++lane) {
+            const BeamSearchStats& part = lanes[lane].stats;
+            stats.expansions += part.expansions;
+            stats.children += part.children;
+            stats.duplicates += part.duplicates;
+            stats.cachedEvals += part.cachedEvals;
+            stats.chanceNodes += part.chanceNodes;
+        }
+    }
+
+    // False when an equal or better line already reached this node at this depth
+    bool claimNode(const Node& node) {
+        uint64_t key = node.board.hash ^ zobristHold(node.stored) ^ zobristQueue(node.next);
+        uint64_t data;
+        if (table.probe(key, data) && uint32_t(data >> 32) == levelStamp &&
+            std::bit_cast<float>(uint32_t(data)) >= node.reward) {
+            return false;
+        }
+        table.store(key, (uint64_t(levelStamp) << 32) | std::bit_cast<uint32_t>(node.reward));
+        return true;
+    }
+
+    float evaluate(Lane& lane, const EvalBoard& board) {
+        uint64_t data;
+        if (table.probe(board.hash, data)) {
+            lane.stats.cachedEvals++;
+            return std::bit_cast<float>(uint32_t(data));
+        }
+        float score = scoreFeatures(computeFeatures(board), weights);
+        table.store(board.hash, std::bit_cast<uint32_t>(score));
+        return score;
+    }
+
+    // Play or hold the next queued piece of a node
+    void expandChildren(Lane& lane, const Node& parent) {
+        if (parent.board.toppedOut || parent.next >= queueLength) return;
+
+        int type = queue[parent.next];
+        Tetrimino piece(type);
+        placeAtSpawn(piece);
+        expand(lane, parent, piece, false, parent.next + 1, parent.stored, false);
+
+        // Holding the same type just replays the line above
+        if (parent.stored >= 0 && parent.stored != type) {
+            expand(lane, parent, Tetrimino(parent.stored), true, parent.next + 1, type, false);
+        } else if (parent.stored < 0 && parent.next + 1 < queueLength) {
+            Tetrimino swapped(queue[parent.next + 1]);
+            placeAtSpawn(swapped);
+            expand(lane, parent, swapped, true, parent.next + 2, type, false);
+        }
+    }
+
+    // Offer every placement of piece on the parent's board to the lane's beam
+    void expand(Lane& lane, const Node& parent, const Tetrimino& piece, bool useHold, int next, int stored, bool isRoot) {
+        if (!parent.board.board.fits(piece.type, piece.rotation, piece.x, piece.y)) return;
+
+        Beam& beam = lane.beam;
+        lane.generator.generate(parent.board.board, piece, isRoot);
+        lane.stats.expansions++;
+        for (const Placement& placement : lane.generator) {
+            Node child;
+            child.board = parent.board;
+            int lines = child.board.place(piece.type, placement.rotation, placement.x, placement.y);
+            child.reward = parent.reward + placementReward(lines, placement.flags, weights);
+            child.next = static_cast<int8_t>(next);
+            child.stored = static_cast<int8_t>(stored);
+            child.root = parent.root;
+            lane.stats.children++;
+
+            child.score = child.board.toppedOut ? TOP_OUT_SCORE : child.reward + evaluate(lane, child.board);
+            if (beam.size == beam.capacity && child.score <= beam.nodes[0].score) continue; // Would not make the beam
+
+            if (!child.board.toppedOut && !claimNode(child)) {
+                lane.stats.duplicates++;
+                continue;
+            }
+
+            // First moves get an entry the line's descendants point back to; only the
+            // calling thread expands the root
+            if (isRoot) {
+                if (rootMoveCount >= ROOT_MOVE_LIMIT) return;
+                SearchMove& move = rootMoves[rootMoveCount];
+                move.found = true;
+                move.useHold = useHold;
+                move.type = piece.type;
+                move.placement = placement;
+                child.root = static_cast<int16_t>(rootMoveCount++);
+            }
+            offer(beam, child);
+        }
+    }
+
+    // Keep child if it is among the best boards the beam has room for
+    static void offer(Beam& beam, const Node& child) {
+        if (beam.size < beam.capacity) {
+            beam.nodes[beam.size++] = child;
+            std::push_heap(beam.nodes, beam.nodes + beam.size, betterScore);
+        } else if (child.score > beam.nodes[0].score) {
+            std::pop_heap(beam.nodes, beam.nodes + beam.size, betterScore);
+            beam.nodes[beam.size - 1] = child;
+            std::push_heap(beam.nodes, beam.nodes + beam.size, betterScore);
+        }
+    }
+
+    // Order a full level best-first, so a deadline cuts off its weakest parents, and report its best line
+    SearchMove finishLevel(Node* nodes, size_t count) {
+        std::sort(nodes, nodes + count, betterScore);
+        SearchMove move = rootMoves[nodes[0].root];
+        move.score = nodes[0].score;
+        return move;
+    }
+
+    // Mean over the possible next pieces of the best thing to do with each
+    float expectedValue(Lane& lane, const Node& node, uint8_t pieces) {
+        uint64_t key = node.board.hash ^ zobristHold(node.stored) ^ zobristPieceSet(pieces);
+        uint64_t data;
+        if (table.probe(key, data)) return std::bit_cast<float>(uint32_t(data));
+
+        // Swapping in the held piece is the same option whatever comes next
+        float holdValue = (node.stored >= 0) ? bestPlacementValue(lane, node.board, Tetrimino(node.stored)) : TOP_OUT_SCORE;
+
+        float total = 0.0f;
+        int count = 0;
+        for (uint8_t rest = pieces; rest; rest &= rest - 1) {
+            Tetrimino piece(std::countr_zero(rest));
+            placeAtSpawn(piece);
+            total += std::max(bestPlacementValue(lane, node.board, piece), holdValue);
+            count++;
+        }
+        float value = count ? total / count : 0.0f;
+
+        lane.stats.chanceNodes++;
+        table.store(key, std::bit_cast<uint32_t>(value));
+        return value;
+    }
+
+    float bestPlacementValue(Lane& lane, const EvalBoard& board, const Tetrimino& piece) {
+        if (!board.board.fits(piece.type, piece.rotation, piece.x, piece.y)) return TOP_OUT_SCORE;
+
+        lane.generator.generate(board.board, piece, false);
+        lane.stats.expansions++;
+        float best = TOP_OUT_SCORE;
+        for (const Placement& placement : lane.generator) {
+            EvalBoard after = board;
+            int lines = after.place(piece.type, placement.rotation, placement.x, placement.y);
+            if (after.toppedOut) continue;
+            best = std::max(best, placementReward(lines, placement.flags, weights) + evaluate(lane, after));
+        }
+        return best;
+    }
+
+    void adaptWidth(int width, bool ranOut, Clock::duration elapsed, Clock::duration budget) {
+        if (ranOut) {
+            beamWidth = std::max(MIN_BEAM_WIDTH, width * 3 / 4);
+        } else if (elapsed * 2 < budget) {
+            beamWidth = std::min(maxBeamWidth, width + std::max(1, width / 4));
+        }
+    }
+};
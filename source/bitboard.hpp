@@ -0,0 +1,150 @@
+/********************************************************************************
+ * File: bitboard.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Compact board representation for search code. Each row is a 16-bit mask
+ *   (bit x set when column x is filled), and each piece orientation is
+ *   precomputed as up to four row masks, so a collision test is a handful of
+ *   AND operations instead of a walk over the 4x4 shape grid.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include "tetrimino.hpp"
+
+constexpr uint16_t FULL_ROW = (1u << BOARD_WIDTH) - 1;
+
+// One orientation of a piece: row masks shifted so the leftmost block sits on bit 0
+struct PieceMask {
+    std::array<uint16_t, 4> rows{};
+    int8_t minCol = 0, maxCol = 0; // Occupied column range inside the 4x4 grid
+    int8_t top = 0, bottom = 0;    // Occupied row range inside the 4x4 grid
+};
+
+using PieceMaskTable = std::array<std::array<PieceMask, 4>, 7>;
+
+inline PieceMaskTable buildPieceMasks() {
+    PieceMaskTable table{};
+    for (int type = 0; type < 7; ++type) {
+        for (int rotation = 0; rotation < 4; ++rotation) {
+            PieceMask& mask = table[type][rotation];
+            int minCol = 4, maxCol = -1, top = 4, bottom = -1;
+            uint16_t rawRows[4] = {0, 0, 0, 0};
+
+            for (int i = 0; i < 4; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    int rotatedIndex = getRotatedIndex(type, i, j, rotation);
+                    if (rotatedIndex < 0 || tetriminoShapes[type][rotatedIndex] == 0) continue;
+                    rawRows[i] |= 1u << j;
+                    minCol = std::min(minCol, j);
+                    maxCol = std::max(maxCol, j);
+                    top = std::min(top, i);
+                    bottom = std::max(bottom, i);
+                }
+            }
+
+            for (int i = 0; i < 4; ++i) mask.rows[i] = rawRows[i] >> minCol;
+            mask.minCol = minCol;
+            mask.maxCol = maxCol;
+            mask.top = top;
+            mask.bottom = bottom;
+        }
+    }
+    return table;
+}
+
+// Built on first use; function-local statics are initialized thread-safely
+inline const PieceMask& pieceMask(int type, int rotation) {
+    static const PieceMaskTable table = buildPieceMasks();
+    return table[type][rotation];
+}
+
+struct Bitboard {
+    std::array<uint16_t, BOARD_HEIGHT> rows{}; // rows[0] is the top of the board
+
+    static Bitboard fromBoard(const std::array<std::array<int, BOARD_WIDTH>, BOARD_HEIGHT>& board) {
+        Bitboard bits;
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            for (int x = 0; x < BOARD_WIDTH; ++x) {
+                if (board[y][x] != 0) bits.rows[y] |= 1u << x;
+            }
+        }
+        return bits;
+    }
+
+    // Same rules as isPositionValid: walls and floor are solid, rows above the board are open
+    bool fits(int type, int rotation, int x, int y) const {
+        return fits(pieceMask(type, rotation), x, y);
+    }
+
+    bool fits(const PieceMask& mask, int x, int y) const {
+        int left = x + mask.minCol;
+        if (left < 0 || x + mask.maxCol >= BOARD_WIDTH || y + mask.bottom >= BOARD_HEIGHT) return false;
+
+        for (int i = mask.top; i <= mask.bottom; ++i) {
+            int row = y + i;
+            if (row >= 0 && (rows[row] & (mask.rows[i] << left))) return false;
+        }
+        return true;
+    }
+
+    // Rows to drop before the piece lands (the hard drop distance)
+    int dropDistance(int type, int rotation, int x, int y) const {
+        int distance = 0;
+        while (fits(type, rotation, x, y + distance + 1)) ++distance;
+        return distance;
+    }
+
+    // Lock a piece into the board; returns false when part of it sits above the top
+    bool place(int type, int rotation, int x, int y) {
+        const PieceMask& mask = pieceMask(type, rotation);
+        int left = x + mask.minCol;
+        bool inside = true;
+
+        for (int i = mask.top; i <= mask.bottom; ++i) {
+            int row = y + i;
+            if (row < 0) {
+                inside = false;
+                continue;
+            }
+            rows[row] |= mask.rows[i] << left;
+        }
+        return inside;
+    }
+
+    // Remove full rows, shifting everything above down; returns the number cleared
+    int clearLines() {
+        int cleared = 0;
+        for (int y = BOARD_HEIGHT - 1; y >= 0; --y) {
+            if (rows[y] == FULL_ROW) {
+                ++cleared;
+            } else if (cleared > 0) {
+                rows[y + cleared] = rows[y];
+            }
+        }
+        for (int y = 0; y < cleared; ++y) rows[y] = 0;
+        return cleared;
+    }
+
+    bool isFilled(int x, int y) const {
+        if (x < 0 || x >= BOARD_WIDTH || y >= BOARD_HEIGHT) return true;
+        if (y < 0) return false;
+        return (rows[y] >> x) & 1;
+    }
+
+    bool isEmpty() const {
+        for (uint16_t row : rows) {
+            if (row) return false;
+        }
+        return true;
+    }
+
+    bool operator==(const Bitboard& other) const { return rows == other.rows; }
+};
@@ -0,0 +1,226 @@
+/********************************************************************************
+ * File: evaluator.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Heuristic board evaluation for the Tetris Overlay's search code. Column
+ *   heights and the filled-cell count are kept alongside the bitboard and
+ *   updated as pieces lock, so aggregate height, holes, bumpiness and wells
+ *   cost a pass over ten columns. Row transitions, column transitions and
+ *   T-slots are counted with popcount over the occupied rows only. The
+ *   board's Zobrist hash is kept up to date the same way.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+
+#include "bitboard.hpp"
+#include "move_generator.hpp"
+#include "zobrist.hpp"
+
+// Feature weights; positive values reward, negative values penalize
+struct EvalWeights {
+    float aggregateHeight   = -0.50f;
+    float maxHeight         = -0.05f;
+    float holes             = -5.00f;
+    float bumpiness         = -0.30f;
+    float wells             = -0.40f;  // Cumulative depth of every well but the deepest
+    float deepestWell       =  0.50f;  // Depth of the deepest well, up to four rows (a Tetris slot)
+    float rowTransitions    = -0.60f;
+    float columnTransitions = -1.00f;
+    float tSlots            =  0.50f;
+    std::array<float, 5> lineClears = {{0.0f, -1.0f, -0.5f, 0.5f, 4.0f}};
+    float tSpinClear        =  3.00f;  // Per line cleared by a T-spin
+
+    bool operator==(const EvalWeights&) const = default;
+};
+
+struct BoardFeatures {
+    int aggregateHeight = 0;
+    int maxHeight = 0;
+    int holes = 0;
+    int bumpiness = 0;
+    int wells = 0;
+    int deepestWell = 0;
+    int rowTransitions = 0;
+    int columnTransitions = 0;
+    int tSlots = 0;
+};
+
+// Bitboard plus the per-column summary the evaluator reads
+struct EvalBoard {
+    Bitboard board;
+    std::array<int8_t, BOARD_WIDTH> heights{}; // Rows from the floor to the top filled cell
+    int cellCount = 0;
+    uint64_t hash = 0;      // zobristHash(board)
+    bool toppedOut = false; // A piece locked partly above the board (game over)
+
+    static EvalBoard fromBitboard(const Bitboard& bits) {
+        EvalBoard eval;
+        eval.board = bits;
+        eval.recompute();
+        return eval;
+    }
+
+    // Rebuild heights top-down: a column's height is set by the first row that covers it
+    void recompute() {
+        heights.fill(0);
+        cellCount = 0;
+        hash = 0;
+        uint16_t covered = 0;
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            uint16_t row = board.rows[y];
+            cellCount += std::popcount(row);
+            hash ^= zobristRow(y, row);
+            for (uint16_t fresh = row & ~covered; fresh; fresh &= fresh - 1) {
+                heights[std::countr_zero(fresh)] = static_cast<int8_t>(BOARD_HEIGHT - y);
+            }
+            covered |= row;
+        }
+    }
+
+    // Lock a piece; heights and hash are patched unless lines clear, which shifts
+    // every row above and rebuilds both. Returns lines cleared.
+    int place(int type, int rotation, int x, int y) {
+        if (!board.place(type, rotation, x, y)) toppedOut = true;
+        int cleared = board.clearLines();
+        if (cleared) {
+            recompute();
+            return cleared;
+        }
+
+        const PieceMask& mask = pieceMask(type, rotation);
+        int left = x + mask.minCol;
+        for (int i = mask.top; i <= mask.bottom; ++i) {
+            for (uint16_t bits = uint16_t(mask.rows[i] << left); bits; bits &= bits - 1) {
+                int column = std::countr_zero(bits);
+                heights[column] = std::max<int8_t>(heights[column], static_cast<int8_t>(BOARD_HEIGHT - (y + i)));
+            }
+        }
+        cellCount += 4;
+        hash ^= zobristPiece(type, rotation, x, y);
+        return 0;
+    }
+
+    int stackTop() const {
+        int top = 0;
+        for (int8_t height : heights) top = std::max<int>(top, height);
+        return BOARD_HEIGHT - top; // First row that holds any block
+    }
+};
+
+inline BoardFeatures computeFeatures(const EvalBoard& eval) {
+    BoardFeatures features;
+    const auto& heights = eval.heights;
+
+    int deepest = 0;
+    for (int x = 0; x < BOARD_WIDTH; ++x) {
+        int height = heights[x];
+        features.aggregateHeight += height;
+        features.maxHeight = std::max(features.maxHeight, height);
+        if (x > 0) features.bumpiness += std::abs(height - heights[x - 1]);
+
+        // Walls count as infinitely tall neighbours
+        int left = (x > 0) ? heights[x - 1] : BOARD_HEIGHT;
+        int right = (x < BOARD_WIDTH - 1) ? heights[x + 1] : BOARD_HEIGHT;
+        int depth = std::min(left, right) - height;
+        if (depth > 0) {
+            features.wells += depth * (depth + 1) / 2;
+            deepest = std::max(deepest, depth);
+        }
+    }
+    features.wells -= deepest * (deepest + 1) / 2;
+    features.deepestWell = std::min(deepest, 4);
+
+    // Every cell below a column's top that is not filled is a hole
+    features.holes = features.aggregateHeight - eval.cellCount;
+
+    const auto& rows = eval.board.rows;
+    constexpr uint32_t WALLED = (1u << (BOARD_WIDTH + 1)) | 1u;
+    constexpr uint32_t EDGES = (1u << (BOARD_WIDTH + 1)) - 1;
+    constexpr uint16_t SLOT_STARTS = FULL_ROW >> 2; // Columns where a 3-wide slot fits
+
+    uint16_t above = 0;
+    for (int y = eval.stackTop(); y < BOARD_HEIGHT; ++y) {
+        uint16_t row = rows[y];
+
+        // Row transitions, with both walls treated as filled
+        uint32_t walled = (uint32_t(row) << 1) | WALLED;
+        features.rowTransitions += std::popcount((walled ^ (walled >> 1)) & EDGES);
+
+        // Column transitions against the row above
+        features.columnTransitions += std::popcount(uint16_t(row ^ above));
+
+        // T-slot: three open cells, the two bottom corners filled with the middle open,
+        // something underneath the middle and an overhang over one of the top corners
+        if (y + 1 < BOARD_HEIGHT) {
+            uint16_t below = rows[y + 1];
+            uint16_t support = (y + 2 < BOARD_HEIGHT) ? rows[y + 2] : FULL_ROW;
+            uint16_t open = ~row, openBelow = ~below, openAbove = ~above;
+            uint16_t slots = open & (open >> 1) & (open >> 2)
+                           & below & (below >> 2) & (openBelow >> 1)
+                           & (support >> 1)
+                           & (above | (above >> 2)) & (openAbove >> 1)
+                           & SLOT_STARTS;
+            features.tSlots += std::popcount(slots);
+        }
+        above = row;
+    }
+    // The floor counts as filled
+    features.columnTransitions += std::popcount(uint16_t(above ^ FULL_ROW));
+
+    return features;
+}
+
+inline float scoreFeatures(const BoardFeatures& features, const EvalWeights& weights) {
+    return weights.aggregateHeight * features.aggregateHeight
+         + weights.maxHeight * features.maxHeight
+         + weights.holes * features.holes
+         + weights.bumpiness * features.bumpiness
+         + weights.wells * features.wells
+         + weights.deepestWell * features.deepestWell
+         + weights.rowTransitions * features.rowTransitions
+         + weights.columnTransitions * features.columnTransitions
+         + weights.tSlots * features.tSlots;
+}
+
+constexpr float TOP_OUT_SCORE = -1.0e9f;
+
+// Reward for what a placement cleared, independent of the board it leaves
+inline float placementReward(int linesCleared, uint8_t placementFlags, const EvalWeights& weights) {
+    float reward = weights.lineClears[std::min(linesCleared, 4)];
+    if (placementFlags & PLACEMENT_TSPIN) reward += weights.tSpinClear * linesCleared;
+    return reward;
+}
+
+// Score of the board left behind, plus the reward for what the placement cleared
+inline float evaluatePlacement(const EvalBoard& after, int linesCleared, uint8_t placementFlags, const EvalWeights& weights) {
+    if (after.toppedOut) return TOP_OUT_SCORE;
+    return scoreFeatures(computeFeatures(after), weights) + placementReward(linesCleared, placementFlags, weights);
+}
+
+// Best generated placement for the piece, or -1 when the generator found none
+inline int pickBestPlacement(const EvalBoard& board, int type, const MoveGenerator& generator,
+                             const EvalWeights& weights, float* bestScore = nullptr) {
+    int best = -1;
+    float top = -std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < generator.size(); ++i) {
+        const Placement& placement = generator[i];
+        EvalBoard after = board;
+        int lines = after.place(type, placement.rotation, placement.x, placement.y);
+        float score = evaluatePlacement(after, lines, placement.flags, weights);
+        if (score > top) {
+            top = score;
+            best = static_cast<int>(i);
+        }
+    }
+    if (bestScore) *bestScore = top;
+    return best;
+}
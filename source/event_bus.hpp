@@ -0,0 +1,91 @@
+/********************************************************************************
+ * File: event_bus.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Game events for the Tetris Overlay. The simulation publishes what just
+ *   happened (a piece locked, lines cleared, a spin, a level up, a top out,
+ *   a hard drop) into a fixed-size single-producer single-consumer ring,
+ *   and the presentation drains it when it draws: particles, banners and
+ *   any future effect live entirely on that side and can be throttled or
+ *   turned off without touching game logic.
+ *
+ *   Events are cosmetic. When the ring is full new events are dropped and
+ *   counted rather than blocking the game, so a stalled consumer can never
+ *   change how a game plays out.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "scoring.hpp"
+
+enum GameEventType : uint8_t {
+    EVENT_PIECE_LOCKED,   // piece, x, y, rotation
+    EVENT_LINES_CLEARED,  // lines, rows, points, banner, backToBack, value = back-to-back count, perfectClear
+    EVENT_SPIN_DETECTED,  // piece, x, y, rotation, spin, lines; points and banner when no lines cleared
+    EVENT_LEVEL_UP,       // value = new level
+    EVENT_TOP_OUT,
+    EVENT_HARD_DROP,      // piece, x, y, rotation where it landed, value = rows dropped
+    EVENT_GAME_RESET      // The board is about to be cleared for a new game
+};
+
+struct GameEvent {
+    GameEventType type = EVENT_PIECE_LOCKED;
+    int8_t piece = -1;
+    int8_t x = 0, y = 0;
+    uint8_t rotation = 0;
+    uint8_t lines = 0;
+    TSpinType spin = TSPIN_NONE;
+    ClearBanner banner = BANNER_NONE;
+    bool backToBack = false;
+    bool perfectClear = false;
+    int32_t value = 0;
+    uint32_t rows = 0;    // Bit y set for each cleared board row, as numbered before the clear
+    int32_t points = 0;
+};
+
+// Lock-free ring for one producer thread and one consumer thread
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // Producer side; false if the ring is full
+    bool push(const T& item) {
+        size_t tail = writeIndex.load(std::memory_order_relaxed);
+        if (tail - readIndex.load(std::memory_order_acquire) >= Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[tail & (Capacity - 1)] = item;
+        writeIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false if the ring is empty
+    bool pop(T& item) {
+        size_t head = readIndex.load(std::memory_order_relaxed);
+        if (head == writeIndex.load(std::memory_order_acquire)) return false;
+        item = slots[head & (Capacity - 1)];
+        readIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::array<T, Capacity> slots{};
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+    std::atomic<size_t> dropped{0};
+};
+
+constexpr size_t GAME_EVENT_CAPACITY = 64;
+using GameEventBus = SpscRing<GameEvent, GAME_EVENT_CAPACITY>;
@@ -0,0 +1,125 @@
+/********************************************************************************
+ * File: finesse.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Finesse analysis for the Tetris Overlay. Every press that moves the
+ *   active piece (a shift, holding a shift for DAS, a soft drop, a rotation)
+ *   is counted from the moment the piece spawns or comes out of hold. When
+ *   the piece locks, the move generator searches the same board from the
+ *   same start and reports the fewest presses that put a piece on the same
+ *   cells; anything the player pressed beyond that is a finesse fault.
+ *
+ *   Presses are counted the way the move generator counts inputs: a held
+ *   shift or soft drop is one press however far it travels, and the final
+ *   hard drop is free.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "move_generator.hpp"
+
+constexpr uint8_t FINESSE_UNKNOWN = 0xFF; // No reachable placement matched the locked piece
+
+// One locked piece: the presses the player used against the fewest that reach its cells
+struct FinesseRecord {
+    uint32_t piece = 0;      // Pieces spawned when it locked
+    int8_t type = 0;
+    int8_t x = 0, y = 0;
+    uint8_t rotation = 0;
+    uint8_t inputs = 0;
+    uint8_t minimal = FINESSE_UNKNOWN;
+
+    int extraInputs() const {
+        return minimal == FINESSE_UNKNOWN ? 0 : std::max(0, int(inputs) - int(minimal));
+    }
+};
+
+class FinesseTracker {
+public:
+    int pieces = 0;        // Pieces judged
+    int faults = 0;        // Pieces that took more presses than needed
+    int wastedInputs = 0;  // Presses beyond the minimum, summed over all pieces
+
+    void reset() {
+        pieces = faults = wastedInputs = 0;
+        start = Tetrimino(-1);
+        inputs = 0;
+    }
+
+    // A new piece became active (spawned or swapped in from hold)
+    void startPiece(const Tetrimino& piece) {
+        start = piece;
+        inputs = 0;
+    }
+
+    void countInput() {
+        if (inputs < FINESSE_UNKNOWN - 1) inputs++;
+    }
+
+    // Judge piece, resting where it is about to lock on board (which does not contain it yet).
+    // rotatedLast is whether its last successful action was a rotation, which decides whether it spun.
+    FinesseRecord lockPiece(const Bitboard& board, const Tetrimino& piece, bool rotatedLast, uint32_t pieceIndex) {
+        FinesseRecord record;
+        record.piece = pieceIndex;
+        record.type = static_cast<int8_t>(piece.type);
+        record.x = static_cast<int8_t>(piece.x);
+        record.y = static_cast<int8_t>(piece.y);
+        record.rotation = static_cast<uint8_t>(piece.rotation);
+        record.inputs = static_cast<uint8_t>(inputs);
+        if (start.type != piece.type) return record;
+
+        // The same cells can be reached with and without a spin; judge against the kind that happened
+        bool spin = piece.type == T_PIECE && rotatedLast && countTSpinCorners(board, piece.x, piece.y) >= 3;
+        uint64_t key = MoveGenerator::cellKey(piece.type, piece.rotation, piece.x, piece.y);
+        bool bestMatchesSpin = false;
+
+        generator.generate(board, start);
+        for (const Placement& placement : generator) {
+            if (MoveGenerator::cellKey(piece.type, placement.rotation, placement.x, placement.y) != key) continue;
+
+            bool matchesSpin = bool(placement.flags & PLACEMENT_TSPIN) == spin;
+            bool better = record.minimal == FINESSE_UNKNOWN || (matchesSpin && !bestMatchesSpin) ||
+                          (matchesSpin == bestMatchesSpin && placement.pathLength < record.minimal);
+            if (better) {
+                record.minimal = placement.pathLength;
+                bestMatchesSpin = matchesSpin;
+            }
+        }
+
+        if (record.minimal != FINESSE_UNKNOWN) {
+            pieces++;
+            if (record.extraInputs() > 0) faults++;
+            wastedInputs += record.extraInputs();
+        }
+        return record;
+    }
+
+private:
+    MoveGenerator generator;
+    Tetrimino start{-1};
+    int inputs = 0;
+};
+
+// Per-piece report as CSV text, one row per locked piece
+inline std::vector<uint8_t> encodeFinesseReport(const std::vector<FinesseRecord>& records) {
+    static constexpr char pieceLetters[] = "IJLOSTZ";
+    std::string text = "piece,type,x,y,rotation,inputs,minimal,extra\n";
+    for (const FinesseRecord& record : records) {
+        text += std::to_string(record.piece) + ',';
+        text += (record.type >= 0 && record.type < 7) ? pieceLetters[record.type] : '?';
+        text += ',' + std::to_string(record.x) + ',' + std::to_string(record.y) + ',' +
+                std::to_string(record.rotation) + ',' + std::to_string(record.inputs) + ',';
+        text += (record.minimal == FINESSE_UNKNOWN) ? std::string() : std::to_string(record.minimal);
+        text += ',' + std::to_string(record.extraInputs()) + '\n';
+    }
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
@@ -0,0 +1,42 @@
+/********************************************************************************
+ * File: game_phase.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Phases of the Tetris Overlay's game loop. A piece in play is Falling
+ *   until it rests on the stack and then Locking. When it locks, the game
+ *   waits out the line-clear delay (only when lines were cleared) and the
+ *   entry delay (ARE) before the next piece appears; both run on the frame
+ *   clock, so replays and saves see exactly the same timing. With both
+ *   delays at zero, as in the Classic handling, the next piece appears in
+ *   the same frame the last one locked.
+ *
+ *   During the delays there is no piece in play. Held directions keep
+ *   charging their auto-shift, and rotate and hold presses are kept for the
+ *   next piece: the initial rotation and initial hold systems (IRS/IHS).
+ *
+ *   Paused and TopOut are reported over the stored phase, so resuming a
+ *   game continues in whichever phase it was paused.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+enum GamePhase : uint8_t {
+    PHASE_FALLING,     // Piece in play and free to fall
+    PHASE_LOCKING,     // Piece in play and resting on the stack; lock delay runs
+    PHASE_LINE_CLEAR,  // Lines were just cleared; waiting out the line-clear delay
+    PHASE_ENTRY,       // Waiting out the entry delay before the next piece
+    PHASE_TOP_OUT,
+    PHASE_PAUSED
+};
+
+// Presses kept during line-clear and entry delay, applied when the next piece appears
+enum EntryInput : uint8_t {
+    ENTRY_ROTATE_CW  = 1 << 0,
+    ENTRY_ROTATE_CCW = 1 << 1,
+    ENTRY_HOLD       = 1 << 2
+};
@@ -0,0 +1,75 @@
+/********************************************************************************
+ * File: handling.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Handling profiles for the Tetris Overlay: how fast held buttons repeat,
+ *   how soft drop and lock delay behave and how long the pauses between
+ *   pieces last. Three profiles are built in; more can be added, or the
+ *   built-in ones overridden by name, in sdmc:/config/tetris/handling.json:
+ *
+ *     {
+ *       "active": "Fast",
+ *       "profiles": [
+ *         {"name": "Fast", "das": 117, "arr": 0, "sdf": 0, "lock_delay": 500,
+ *          "lock_extension": 500, "move_resets": 15, "are": 0, "line_clear_delay": 0}
+ *       ]
+ *     }
+ *
+ *   Fields left out keep the Classic values. The file is read once at
+ *   startup; switching profiles afterwards only picks another entry. A game
+ *   keeps the settings it started with, which travel in its save record
+ *   and replay keyframes so playback always runs with the same handling.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct HandlingSettings {
+    uint16_t dasMs;             // Delay before a held shift repeats
+    uint16_t arrMs;             // Between repeats; 0 moves to the wall at once
+    uint16_t softDropFactor;    // Soft drop speed as a multiple of gravity; 0 is instant
+    uint16_t lockDelayMs;       // Time on the floor before the piece locks
+    uint16_t lockExtensionMs;   // Quiet time needed after the last move or rotation before it locks
+    uint16_t moveResetLimit;    // Moves and rotations on the floor that restart lock delay
+    uint16_t areMs;             // Entry delay before the next piece appears
+    uint16_t lineClearDelayMs;  // Extra entry delay after a line clear
+};
+
+constexpr size_t HANDLING_FIELD_COUNT = 8;
+constexpr size_t HANDLING_NAME_SIZE = 16;
+constexpr size_t MAX_HANDLING_PROFILES = 8;
+
+struct HandlingProfile {
+    char name[HANDLING_NAME_SIZE];
+    HandlingSettings settings;
+};
+
+// Key names in handling.json and field order in save records
+constexpr std::array<const char*, HANDLING_FIELD_COUNT> HANDLING_FIELD_NAMES = {{
+    "das", "arr", "sdf", "lock_delay", "lock_extension", "move_resets", "are", "line_clear_delay"
+}};
+
+constexpr HandlingSettings CLASSIC_HANDLING = {300, 40, 20, 500, 500, 15, 0, 0};
+
+constexpr std::array<HandlingProfile, 3> BUILT_IN_HANDLING = {{
+    {"Classic", CLASSIC_HANDLING},
+    {"Guideline", {167, 33, 20, 500, 500, 15, 100, 300}},
+    {"Fast", {117, 0, 0, 500, 500, 15, 0, 0}}
+}};
+
+inline std::array<uint16_t, HANDLING_FIELD_COUNT> toHandlingFields(const HandlingSettings& settings) {
+    return {{
+        settings.dasMs, settings.arrMs, settings.softDropFactor, settings.lockDelayMs,
+        settings.lockExtensionMs, settings.moveResetLimit, settings.areMs, settings.lineClearDelayMs
+    }};
+}
+
+inline HandlingSettings fromHandlingFields(const std::array<uint16_t, HANDLING_FIELD_COUNT>& fields) {
+    return {fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7]};
+}
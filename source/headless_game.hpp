@@ -0,0 +1,176 @@
+/********************************************************************************
+ * File: headless_game.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Placement-level Tetris game without rendering or input timing, for
+ *   self-play tools. It follows the overlay's rules: the same seeded piece
+ *   sequence, hold behaviour, drop points, scoreLock() scoring and level
+ *   progression. Instead of button frames it takes whole
+ *   search moves; each move is expanded with buildAutoplayPlan, exactly as
+ *   the autoplay bot would press it, so soft and hard drop points match
+ *   what the bot scores in the overlay. Gravity and lock delay are not
+ *   modelled. T-spins go through the same lock-time classifier, with the
+ *   last rotation and its kick read back from the plan.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "autoplay.hpp"
+#include "beam_search.hpp"
+#include "bitboard.hpp"
+#include "scoring.hpp"
+#include "tspin.hpp"
+
+enum TopOutCause : uint8_t {
+    TOP_OUT_NONE,
+    TOP_OUT_BLOCK_OUT,  // A new piece spawned on top of the stack
+    TOP_OUT_LOCK_OUT,   // A piece locked partly above the board
+    TOP_OUT_NO_MOVE,    // The search had no placement to offer
+    TOP_OUT_CAUSE_COUNT
+};
+
+class HeadlessGame {
+public:
+    static constexpr int LINES_PER_LEVEL = 10;
+
+    Bitboard board;
+    int current = 0;
+    std::array<int, SEARCH_PREVIEW_SIZE> preview{};
+    int stored = -1;
+    bool hasSwapped = false;
+
+    uint64_t score = 0;
+    int lines = 0;
+    int level = 1;
+    int pieces = 0;                  // Pieces locked
+    std::array<int, 5> clears{};     // Placements by lines cleared
+    int tSpinClears = 0;
+    int perfectClears = 0;
+    TopOutCause topOut = TOP_OUT_NONE;
+
+    // Same piece order as TetrisGui::newGame for the same seed
+    void reset(uint64_t seed) {
+        *this = HeadlessGame();
+        rng.seed(seed);
+        current = rng.next();
+        for (int& type : preview) type = rng.next();
+        spawnCheck();
+    }
+
+    bool over() const { return topOut != TOP_OUT_NONE; }
+
+    SearchSituation situation() const {
+        SearchSituation situation;
+        situation.board = board;
+        situation.current = Tetrimino(current);
+        placeAtSpawn(situation.current);
+        situation.stored = stored;
+        situation.canHold = !hasSwapped;
+        for (size_t i = 0; i < preview.size(); ++i) situation.preview[i] = static_cast<int8_t>(preview[i]);
+        situation.nextPieces = rng.possibleNext();
+        return situation;
+    }
+
+    // Play one search move from situation(); false once the game is over
+    bool play(const SearchMove& move) {
+        if (over()) return false;
+
+        SearchSituation before = situation();
+        if (!buildAutoplayPlan(before, move, plan)) {
+            topOut = TOP_OUT_NO_MOVE;
+            return false;
+        }
+
+        if (move.useHold) {
+            hasSwapped = true;
+            if (stored < 0) {
+                stored = current;
+                advanceQueue();
+                if (!spawnCheck()) return false;
+            } else {
+                std::swap(stored, current);
+            }
+        }
+
+        // Soft drops pay a point per row and the final hard drop two
+        int softDropRows = 0;
+        bool rotatedLast = false, farKick = false;
+        for (const AutoplayFrame& frame : plan) {
+            if (frame.buttons == REPLAY_DOWN) softDropRows++;
+            if (frame.buttons & (REPLAY_LEFT | REPLAY_RIGHT | REPLAY_DOWN)) rotatedLast = false;
+            if (frame.buttons & (REPLAY_A | REPLAY_B)) {
+                int direction = (frame.buttons & REPLAY_A) ? -1 : 1;
+                rotatedLast = true;
+                farKick = tryRotate(board, move.type, frame.x, frame.y, frame.rotation, direction).farKick;
+            }
+        }
+        const Placement& placement = move.placement;
+        score += uint64_t(placement.y - plan.back().y) * 2;
+        TSpinType spin = classifyTSpin(move.type, placement.rotation, tSpinCorners(board, placement.x, placement.y),
+                                       rotatedLast, farKick);
+
+        if (!board.place(move.type, placement.rotation, placement.x, placement.y)) {
+            topOut = TOP_OUT_LOCK_OUT;
+            return false;
+        }
+        score += softDropRows;
+        pieces++;
+
+        int cleared = board.clearLines();
+        scorePiece(cleared, spin);
+
+        hasSwapped = false;
+        advanceQueue();
+        return spawnCheck();
+    }
+
+private:
+    PieceRandomizer rng;
+    int linesForLevelUp = 0;
+    ScoringState scoring;
+    std::vector<AutoplayFrame> plan;
+
+    void advanceQueue() {
+        current = preview[0];
+        for (size_t i = 0; i + 1 < preview.size(); ++i) preview[i] = preview[i + 1];
+        preview.back() = rng.next();
+    }
+
+    bool spawnCheck() {
+        Tetrimino piece(current);
+        placeAtSpawn(piece);
+        if (!board.fits(piece.type, piece.rotation, piece.x, piece.y)) topOut = TOP_OUT_BLOCK_OUT;
+        return !over();
+    }
+
+    // Mirrors TetrisGui::clearLines
+    void scorePiece(int cleared, TSpinType spin) {
+        bool perfectClear = false;
+        if (cleared) {
+            perfectClear = true;
+            for (uint16_t row : board.rows) {
+                if (row) perfectClear = false;
+            }
+        }
+        score += uint64_t(scoreLock(scoring, cleared, spin, perfectClear, level).points);
+        if (!cleared) return;
+
+        lines += cleared;
+        clears[cleared]++;
+        if (spin != TSPIN_NONE) tSpinClears++;
+        if (perfectClear) perfectClears++;
+
+        linesForLevelUp += cleared;
+        if (linesForLevelUp >= LINES_PER_LEVEL) {
+            linesForLevelUp -= LINES_PER_LEVEL;
+            level++;
+        }
+    }
+};
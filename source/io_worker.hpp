@@ -0,0 +1,233 @@
+/********************************************************************************
+ * File: io_worker.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Crash-safe, asynchronous file I/O for the Tetris Overlay. Files are
+ *   replaced atomically (temp file, fsync, rename) by a background worker
+ *   that serializes and writes queued requests, so saves and replays never
+ *   put SD card latency on the UI thread. Shutdown flushes with a bounded
+ *   wait.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Replace path with data so that a crash leaves either the old or the new file intact
+inline bool writeFileAtomically(const std::string& path, const std::vector<uint8_t>& data) {
+    std::string tempPath = path + ".tmp";
+
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) return false;
+
+    bool success = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    success = (std::fflush(file) == 0) && success;
+    success = (fsync(fileno(file)) == 0) && success;
+    success = (std::fclose(file) == 0) && success;
+    if (!success) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        // Some file systems refuse to rename over an existing file; the intact
+        // temp file is picked up by readFileWithFallback() if we die in between
+        std::remove(path.c_str());
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0) return false;
+    }
+    return true;
+}
+
+// Read a file written by writeFileAtomically(); isValid decides whether to fall
+// back to the temp file of an interrupted replace
+template <typename Validator>
+bool readFileWithFallback(const std::string& path, std::vector<uint8_t>& data, Validator isValid) {
+    for (const std::string& candidate : {path, path + ".tmp"}) {
+        FILE* file = std::fopen(candidate.c_str(), "rb");
+        if (!file) continue;
+
+        data.clear();
+        uint8_t buffer[512];
+        size_t bytesRead;
+        while ((bytesRead = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            data.insert(data.end(), buffer, buffer + bytesRead);
+        }
+        std::fclose(file);
+
+        if (isValid(data)) return true;
+    }
+    return false;
+}
+
+
+// Background file writer with a small request queue. Requests carry a serializer
+// that runs on the worker thread, so the UI thread only captures state. A pending
+// request for a path is replaced by newer ones, and writes to the same path can be
+// spaced by a minimum interval. Past capacity the oldest sheddable request (a
+// report that can be lost) gives way; any other request grows the queue instead,
+// which stays small since there is at most one request per path.
+class IoWorker {
+public:
+    using Serializer = std::function<std::vector<uint8_t>()>;
+
+    explicit IoWorker(size_t capacity = 8, std::chrono::milliseconds shutdownTimeout = std::chrono::milliseconds(1000))
+        : state(std::make_shared<State>()), shutdownTimeout(shutdownTimeout) {
+        state->capacity = capacity;
+        thread = std::thread(&IoWorker::run, state);
+    }
+
+    ~IoWorker() {
+        shutdown(shutdownTimeout);
+    }
+
+    // Queue a write; urgent requests skip minInterval (pause, hide, close)
+    void submit(const std::string& path, Serializer serialize, bool urgent,
+                std::chrono::milliseconds minInterval = std::chrono::milliseconds(0), bool sheddable = false) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            auto it = std::find_if(state->queue.begin(), state->queue.end(),
+                [&path](const Request& request) { return request.path == path; });
+            if (it != state->queue.end()) {
+                it->serialize = std::move(serialize);
+                it->urgent = it->urgent || urgent;
+                it->minInterval = minInterval;
+                it->sheddable = it->sheddable && sheddable;
+            } else {
+                if (state->queue.size() >= state->capacity) {
+                    // Never block the caller; shed the oldest write that may be lost
+                    auto shed = std::find_if(state->queue.begin(), state->queue.end(),
+                        [](const Request& request) { return request.sheddable; });
+                    if (shed != state->queue.end()) {
+                        state->queue.erase(shed);
+                        state->dropped++;
+                    }
+                }
+                state->queue.push_back({path, std::move(serialize), urgent, minInterval, sheddable});
+            }
+        }
+        state->wake.notify_one();
+    }
+
+    // Sheddable requests that gave way to newer ones
+    uint32_t droppedCount() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->dropped;
+    }
+
+    // Flush everything still queued, waiting at most timeout; returns false if the
+    // deadline passed (the thread is then left to finish on its own)
+    bool shutdown(std::chrono::milliseconds timeout) {
+        if (!thread.joinable()) return true;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->stopping = true;
+        }
+        state->wake.notify_one();
+
+        bool finished;
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            finished = state->drained.wait_for(lock, timeout, [this] { return state->queue.empty() && !state->busy; });
+        }
+        if (finished) {
+            thread.join();
+        } else {
+            thread.detach(); // The shared state keeps the thread valid until it is done
+        }
+        return finished;
+    }
+
+private:
+    struct Request {
+        std::string path;
+        Serializer serialize;
+        bool urgent;
+        std::chrono::milliseconds minInterval;
+        bool sheddable;
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable drained;
+        std::deque<Request> queue;
+        size_t capacity = 8;
+        bool stopping = false;
+        bool busy = false;
+        uint32_t dropped = 0;
+        std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> lastWrites;
+    };
+
+    std::shared_ptr<State> state;
+    std::chrono::milliseconds shutdownTimeout;
+    std::thread thread;
+
+    static void run(std::shared_ptr<State> state) {
+        auto lastWriteOf = [&state](const std::string& path) {
+            for (const auto& entry : state->lastWrites) {
+                if (entry.first == path) return entry.second;
+            }
+            return std::chrono::steady_clock::time_point();
+        };
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        while (true) {
+            if (state->queue.empty()) {
+                state->drained.notify_all();
+                if (state->stopping) break;
+                state->wake.wait(lock);
+                continue;
+            }
+
+            // Pick the first request that is due, or sleep until the earliest one is
+            auto now = std::chrono::steady_clock::now();
+            auto earliest = std::chrono::steady_clock::time_point::max();
+            auto next = state->queue.end();
+            for (auto it = state->queue.begin(); it != state->queue.end(); ++it) {
+                auto due = lastWriteOf(it->path) + it->minInterval;
+                if (it->urgent || state->stopping || due <= now) {
+                    next = it;
+                    break;
+                }
+                earliest = std::min(earliest, due);
+            }
+            if (next == state->queue.end()) {
+                state->wake.wait_until(lock, earliest);
+                continue;
+            }
+
+            Request request = std::move(*next);
+            state->queue.erase(next);
+            state->busy = true;
+
+            lock.unlock();
+            std::vector<uint8_t> data = request.serialize();
+            if (!data.empty()) writeFileAtomically(request.path, data);
+            lock.lock();
+
+            state->busy = false;
+            auto written = std::find_if(state->lastWrites.begin(), state->lastWrites.end(),
+                [&request](const auto& entry) { return entry.first == request.path; });
+            if (written != state->lastWrites.end()) {
+                written->second = std::chrono::steady_clock::now();
+            } else {
+                state->lastWrites.emplace_back(request.path, std::chrono::steady_clock::now());
+            }
+        }
+    }
+};
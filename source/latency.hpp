@@ -0,0 +1,107 @@
+/********************************************************************************
+ * File: latency.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Input-to-screen latency measurement for the Tetris Overlay. The game
+ *   gives every visible change of the piece state a new version number.
+ *   When a button press changes the state, the time it arrived is kept
+ *   together with the version it produced. The renderer reports each
+ *   version it finishes drawing, and the first frame that shows a pending
+ *   version closes it as one latency sample.
+ *
+ *   The samples go into a histogram with one-millisecond buckets, which is
+ *   shown on the pause screen and written next to the replay after each game.
+ *   A drawn frame is the last point the overlay can see, so the figures do
+ *   not include the display's own scan-out.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LatencyHistogram {
+    static constexpr int BUCKETS = 100; // One per millisecond; the last one also takes everything slower
+
+    std::array<uint32_t, BUCKETS> counts{};
+    uint32_t samples = 0;
+    uint32_t maxMs = 0;
+
+    void add(uint32_t ms) {
+        counts[ms < BUCKETS ? ms : BUCKETS - 1]++;
+        samples++;
+        if (ms > maxMs) maxMs = ms;
+    }
+
+    // Smallest latency in milliseconds that at least fraction of the samples stay within
+    uint32_t percentile(double fraction) const {
+        if (samples == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(fraction * samples + 0.999999);
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (int ms = 0; ms < BUCKETS; ++ms) {
+            seen += counts[ms];
+            if (seen >= target) return (ms == BUCKETS - 1) ? maxMs : ms;
+        }
+        return maxMs;
+    }
+};
+
+class LatencyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A button edge that arrived at edgeTime moved the game to version
+    void inputApplied(Clock::time_point edgeTime, uint32_t version) {
+        if (pendingCount == pending.size()) return; // Nothing is being drawn; keep the oldest presses
+        pending[pendingCount++] = {edgeTime, version};
+    }
+
+    // A frame showing version finished drawing at now
+    void presented(uint32_t version, Clock::time_point now) {
+        size_t kept = 0;
+        for (size_t i = 0; i < pendingCount; ++i) {
+            if (int32_t(version - pending[i].version) >= 0) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - pending[i].edgeTime).count();
+                histogram.add(static_cast<uint32_t>(elapsed < 0 ? 0 : elapsed));
+            } else {
+                pending[kept++] = pending[i];
+            }
+        }
+        pendingCount = kept;
+    }
+
+    void reset() {
+        histogram = LatencyHistogram();
+        pendingCount = 0;
+    }
+
+    const LatencyHistogram& results() const { return histogram; }
+
+private:
+    struct Probe {
+        Clock::time_point edgeTime;
+        uint32_t version;
+    };
+
+    LatencyHistogram histogram;
+    std::array<Probe, 16> pending{};
+    size_t pendingCount = 0;
+};
+
+// Histogram as CSV text, one row per millisecond bucket that has samples
+inline std::vector<uint8_t> encodeLatencyReport(const LatencyHistogram& histogram) {
+    std::string text = "latency_ms,samples\n";
+    for (int ms = 0; ms < LatencyHistogram::BUCKETS; ++ms) {
+        if (histogram.counts[ms] == 0) continue;
+        text += (ms == LatencyHistogram::BUCKETS - 1) ? std::to_string(ms) + "+" : std::to_string(ms);
+        text += ',' + std::to_string(histogram.counts[ms]) + '\n';
+    }
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
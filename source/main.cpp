@@ -39,6 +39,25 @@
 #include <chrono>
 #include <random>
 #include <mutex>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "tetrimino.hpp"
+#include "replay.hpp"
+#include "save_format.hpp"
+#include "io_worker.hpp"
+#include "search_worker.hpp"
+#include "autoplay.hpp"
+#include "weights_file.hpp"
+#include "finesse.hpp"
+#include "scoring.hpp"
+#include "event_bus.hpp"
+#include "tspin.hpp"
+#include "auto_shift.hpp"
+#include "latency.hpp"
+#include "handling.hpp"
+#include "game_phase.hpp"
 
 using namespace ult;
 
@@ -57,87 +76,11 @@ struct Particle {
 
 
 std::vector<Particle> particles;
+constexpr size_t MAX_PARTICLES = 2400;
+constexpr int EXPLOSION_PARTICLES_PER_CELL = 3; // 600 for the whole board
 
-
-// Define the Tetrimino shapes
-const std::array<std::array<size_t, 16>, 7> tetriminoShapes = {{
-    // I
-    { 0,0,0,0,
-      1,1,1,1,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // J
-    { 1,0,0,0,
-      1,1,1,0,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // L
-    { 0,0,1,0,
-      1,1,1,0,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // O
-    { 1,1,0,0,
-      1,1,0,0,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // S
-    { 0,1,1,0,
-      1,1,0,0,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // T
-    { 0,1,0,0,
-      1,1,1,0,
-      0,0,0,0,
-      0,0,0,0 },
-
-    // Z
-    { 1,1,0,0,
-      0,1,1,0,
-      0,0,0,0,
-      0,0,0,0 }
-}};
-
-// Adjusted rotation centers based on official Tetris SRS
-const std::array<std::pair<int, int>, 7> rotationCenters = {{
-    {1.5f, 1.5f}, // I piece (rotating around the second cell in a 4x4 grid)
-    {1, 1}, // J piece
-    {1, 1}, // L piece
-    {1, 1}, // O piece
-    {1, 1}, // S piece
-    {1, 1}, // T piece
-    {1, 1}  // Z piece
-}};
-
-// Wall kicks for I piece (SRS)
-const std::array<std::array<std::pair<int, int>, 5>, 4> wallKicksI = {{
-    // 0 -> 1, 1 -> 0
-    {{ {0, 0}, {-2, 0}, {1, 0}, {-2, -1}, {1, 2} }},
-    // 1 -> 2, 2 -> 1
-    {{ {0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1} }},
-    // 2 -> 3, 3 -> 2
-    {{ {0, 0}, {2, 0}, {-1, 0}, {2, 1}, {-1, -2} }},
-    // 3 -> 0, 0 -> 3
-    {{ {0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1} }}
-}};
-
-// Wall kicks for J, L, S, T, Z pieces (SRS)
-const std::array<std::array<std::pair<int, int>, 5>, 4> wallKicksJLSTZ = {{
-    // 0 -> 1, 1 -> 0
-    {{ {0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2} }},
-    // 1 -> 2, 2 -> 1
-    {{ {0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2} }},
-    // 2 -> 3, 3 -> 2
-    {{ {0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2} }},
-    // 3 -> 0, 0 -> 3
-    {{ {0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2} }}
-}};
+GameEventBus gameEvents;  // Published by TetrisGui, drained by TetrisElement::draw
+LatencyTracker inputLatency;  // Button presses timed until a drawn frame shows their effect
 
 
 // Define colors for each Tetrimino
@@ -151,119 +94,22 @@ const std::array<tsl::Color, 7> tetriminoColors = {{
     {0xE, 0x0, 0x0, 0xF}  // Red - Z (R=F, G=0, B=0, A=F)
 }};
 
-// Board dimensions
-const int BOARD_WIDTH = 10;
-const int BOARD_HEIGHT = 20;
-
-// Updated helper function to get rotated index
-int getRotatedIndex(int type, int i, int j, int rotation) {
-    // Ensure i and j are within bounds
-    if (i < 0 || i >= 4 || j < 0 || j >= 4) return -1;
-
-    if (type == 0) { // I piece
-        int rotatedIndex = 0;
-        switch (rotation) {
-            case 0: rotatedIndex = i * 4 + j; break;
-            case 1: rotatedIndex = (3 - i) + j * 4; break;
-            case 2: rotatedIndex = (3 - j) + (3 - i) * 4; break;
-            case 3: rotatedIndex = i + (3 - j) * 4; break;
-        }
-        return rotatedIndex;
-    } else if (type == 3) { // O piece doesn't rotate
-        return i * 4 + j;
-    } else {
-        // General case for other pieces
-        float centerX = rotationCenters[type].first;
-        float centerY = rotationCenters[type].second;
-        int relX = j - centerX;
-        int relY = i - centerY;
-        int rotatedX, rotatedY;
-
-        switch (rotation) {
-            case 0: rotatedX = relX; rotatedY = relY; break;
-            case 1: rotatedX = -relY; rotatedY = relX; break;
-            case 2: rotatedX = -relX; rotatedY = -relY; break;
-            case 3: rotatedX = relY; rotatedY = -relX; break;
-        }
-
-        int finalX = static_cast<int>(round(rotatedX + centerX));
-        int finalY = static_cast<int>(round(rotatedY + centerY));
-
-        // Ensure the rotated index is within the 4x4 grid
-        if (finalX < 0 || finalX >= 4 || finalY < 0 || finalY >= 4) return -1;
-        return finalY * 4 + finalX;
-    }
-}
-
-
-
-
-
-struct Tetrimino {
-    int x, y;
-    int type;
-    int rotation;
-    Tetrimino(int t) : x(BOARD_WIDTH / 2 - 2), y(0), type(t), rotation(0) {}
-};
-
-// Function to check if the current position of a Tetrimino is valid
-bool isPositionValid(const Tetrimino& tet, const std::array<std::array<int, BOARD_WIDTH>, BOARD_HEIGHT>& board) {
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            int rotatedIndex = getRotatedIndex(tet.type, i, j, tet.rotation);
-
-            // Only check cells that contain a block
-            if (tetriminoShapes[tet.type][rotatedIndex] != 0) {
-                int x = tet.x + j;
-                int y = tet.y + i;
-
-                // Check if x and y are within the bounds of the board horizontally
-                if (x < 0 || x >= BOARD_WIDTH) {
-                    return false;  // Invalid if out of bounds
-                }
-
-                // Allow blocks above the board but not below the bottom
-                if (y >= BOARD_HEIGHT) {
-                    return false;  // Invalid if out of bounds vertically
-                }
-
-                // If the block is above the visible board, ignore it
-                if (y < 0) {
-                    continue;  // Skip rows above the board
-                }
-
-                // Check if the block space is occupied
-                if (board[y][x] != 0) {
-                    return false;  // Invalid if space is occupied
-                }
-            }
-        }
-    }
-    return true;  // Position is valid
-}
-
-
-
-
 float countOffset = 0.0f;
 float counter;
 
-// Helper function to calculate where the Tetrimino will land if hard dropped
-int calculateDropDistance(const Tetrimino& tet, const std::array<std::array<int, BOARD_WIDTH>, BOARD_HEIGHT>& board) {
-    int dropDistance = 0;
-    Tetrimino tempTetrimino = tet;  // Create a temporary copy for simulation
-    while (isPositionValid(tempTetrimino, board)) {
-        tempTetrimino.y += 1;  // Move down one row
-        dropDistance++;
-    }
-    return std::max(dropDistance - 1, 0);  // Ensure the dropDistance doesn't go negative
-}
-
 
 class TetrisElement : public tsl::elm::Element {
 public:
     static bool paused;
     static uint64_t maxHighScore; // Change to a larger data type
+    static std::string replayLabel; // Shown while a replay is playing back (empty otherwise)
+    static bool showHint; // Draw the suggested placement for the current piece
+    static std::string autoplayLabel; // Shown while the autoplay bot is on (empty otherwise)
+    static std::string handlingLabel; // Selected handling profile, shown on the pause screen
+    Tetrimino hintTetrimino = Tetrimino(-1); // Suggested landing spot (type -1 when there is none)
+    int finesseFaults = 0; // Pieces this game that took more presses than needed
+    bool perfectClearAvailable = false; // The current piece, hold and preview can clear the whole board
+    uint32_t stateVersion = 0; // Version of the piece state this element shows
     bool gameOver = false; // Add this line
 
     // Variables for line clear text animation
@@ -283,6 +129,12 @@ public:
           _w(w), _h(h) {}
 
     virtual void draw(tsl::gfx::Renderer* renderer) override {
+        // Report the drawn state version once the frame is complete, however draw returns
+        struct PresentedReport {
+            uint32_t version;
+            ~PresentedReport() { inputLatency.presented(version, std::chrono::steady_clock::now()); }
+        } presentedReport{stateVersion};
+
         // Center the board in the frame
         int boardWidthInPixels = BOARD_WIDTH * _w;
         int boardHeightInPixels = BOARD_HEIGHT * _h;
@@ -388,17 +240,39 @@ public:
         std::ostringstream levelStr;
         levelStr << "Level\n" << level;
         renderer->drawString(levelStr.str().c_str(), false, offsetX + BOARD_WIDTH * _w + 14, offsetY + (BORDER_HEIGHT + 12)*3 + 63, 18, tsl::Color({0xF, 0xF, 0xF, 0xF}));
+
+        // Draw the finesse fault count under the hold box
+        std::ostringstream faultsStr;
+        faultsStr << "Faults\n" << finesseFaults;
+        renderer->drawString(faultsStr.str().c_str(), false, offsetX - 61, offsetY + BORDER_HEIGHT + 30, 18, tsl::Color({0xF, 0xF, 0xF, 0xF}));
+
+        // Draw the perfect clear indicator
+        if (perfectClearAvailable && replayLabel.empty() && !paused && !gameOver) {
+            renderer->drawString("PC", false, offsetX - 61, offsetY + BORDER_HEIGHT + 90, 18, tsl::Color({0x0, 0xF, 0x0, 0xF}));
+        }
         
+        // Draw the replay or autoplay indicator
+        if (!replayLabel.empty()) {
+            renderer->drawString(replayLabel.c_str(), false, offsetX + BOARD_WIDTH * _w + 14, offsetY + (BORDER_HEIGHT + 12)*3 + 108, 18, tsl::Color({0x0, 0xF, 0x0, 0xF}));
+        } else if (!autoplayLabel.empty()) {
+            renderer->drawString(autoplayLabel.c_str(), false, offsetX + BOARD_WIDTH * _w + 14, offsetY + (BORDER_HEIGHT + 12)*3 + 108, 18, tsl::Color({0x0, 0xF, 0x0, 0xF}));
+        }
 
         renderer->drawString("", false, 74, offsetY + 74, 18, tsl::Color({0xF, 0xF, 0xF, 0xF}));
 
         std::lock_guard<std::mutex> lock(boardMutex);  // Lock the mutex while rendering
         
+        // Draw the suggested placement underneath the active piece
+        if (showHint && hintTetrimino.type >= 0 && replayLabel.empty() && !paused && !gameOver) {
+            drawHintTetrimino(renderer, hintTetrimino, offsetX, offsetY);
+        }
+
         // Draw the current Tetrimino
         drawTetrimino(renderer, *currentTetrimino, offsetX, offsetY);
 
 
         // Update the particles
+        drainEvents();
         updateParticles(offsetX, offsetY);
         drawParticles(renderer, offsetX, offsetY);
         
@@ -460,6 +334,18 @@ public:
                 
                 // Draw "Paused" at the center of the board
                 renderer->drawString("Paused", false, centerX - textWidth / 2, centerY, 24, greenColor);
+
+                // Median and 95th percentile input latency of this game so far
+                const LatencyHistogram& latency = inputLatency.results();
+                if (latency.samples > 0) {
+                    std::string latencyLine = "Input lag " + std::to_string(latency.percentile(0.5)) + " / " +
+                                              std::to_string(latency.percentile(0.95)) + " ms";
+                    int latencyWidth = tsl::gfx::calculateStringWidth(latencyLine, 15);
+                    renderer->drawString(latencyLine, false, centerX - latencyWidth / 2, centerY + 30, 15, tsl::Color({0xA, 0xA, 0xA, 0xF}));
+                }
+
+                int handlingWidth = tsl::gfx::calculateStringWidth(handlingLabel, 15);
+                renderer->drawString(handlingLabel, false, centerX - handlingWidth / 2, centerY + 52, 15, tsl::Color({0xA, 0xA, 0xA, 0xF}));
             }
         }
         if (!gameOver) {
@@ -655,6 +541,131 @@ public:
         this->setBoundaries(parentX, parentY, parentWidth, parentHeight);
     }
 
+    // Apply what the game published since the last frame; runs on the drawing side only
+    void drainEvents() {
+        std::lock_guard<std::mutex> lock(particleMutex);
+        GameEvent event;
+        while (gameEvents.pop(event)) {
+            switch (event.type) {
+                case EVENT_HARD_DROP:
+                    createImpactParticles(pieceFromEvent(event), event.value);
+                    break;
+                case EVENT_LINES_CLEARED:
+                    for (int row = 0; row < BOARD_HEIGHT; ++row) {
+                        if (event.rows & (1u << row)) createLineClearParticles(row);
+                    }
+                    showBanner(event);
+                    break;
+                case EVENT_SPIN_DETECTED:
+                    if (event.lines == 0 && event.points > 0) showBanner(event);  // Spins that clear lines are announced with the clear
+                    break;
+                case EVENT_GAME_RESET:
+                    createCenterExplosionParticles();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // Drop every running effect, e.g. after skipping through a replay
+    void clearEffects() {
+        std::lock_guard<std::mutex> lock(particleMutex);
+        particles.clear();
+        showText = false;
+    }
+
+    void createLineClearParticles(int row) {
+        for (int x = 0; x < BOARD_WIDTH; ++x) {
+            for (int p = 0; p < 10; ++p) {
+                spawnParticle(Particle{
+                    static_cast<float>(x * _w + _w / 2),
+                    static_cast<float>(row * _h + _h / 2),
+                    (rand() % 100 / 50.0f - 1.0f) * 8,
+                    (rand() % 100 / 50.0f - 1.0f) * 8,
+                    0.5f,
+                    1.0f
+                });
+            }
+        }
+    }
+
+    // Burst from every cell of the board, EXPLOSION_PARTICLES_PER_CELL each
+    void createCenterExplosionParticles() {
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            for (int x = 0; x < BOARD_WIDTH; ++x) {
+                for (int p = 0; p < EXPLOSION_PARTICLES_PER_CELL; ++p) {
+                    spawnParticle(Particle{
+                        static_cast<float>(x * _w + _w / 2),  // X position at the cell center
+                        static_cast<float>(y * _h + _h / 2),  // Y position at the cell center
+                        (rand() % 100 / 50.0f - 1.0f) * 8,  // Random velocity in X direction
+                        (rand() % 100 / 50.0f - 1.0f) * 8,  // Random velocity in Y direction
+                        0.5f,  // Lifespan
+                        1.0f   // Initial alpha (fully visible)
+                    });
+                }
+            }
+        }
+    }
+
+    // Dust kicked up under a piece that was hard dropped dropDistance rows
+    void createImpactParticles(const Tetrimino& piece, int dropDistance) {
+        // Cap the maximum drop distance to avoid excessive velocity
+        float velocityFactor = std::min(dropDistance / 10.0f, 2.0f);  // Adjust the divisor and cap for desired effect
+        
+        // Set minimum and maximum horizontal and vertical velocities
+        float minVelocity = 0.5f;  // Minimum velocity value
+        float maxHorizontalVelocity = 2.0f * velocityFactor;
+        float maxVerticalVelocity = 4.0f * velocityFactor;
+        
+        // Calculate lifespan based on drop distance with a minimum of 0.2 and a maximum of 0.6
+        float lifespanFactor = std::clamp(dropDistance / 20.0f, 0.2f, 0.6f);
+        
+        // Calculate the number of particles based on drop distance, clamped between 2 and 5 particles
+        int particleCount = std::clamp(2 + dropDistance / 5, 2, 5);
+
+        int bottomRow;
+        int rotatedIndex;
+        int blockX, blockY;
+        Particle particle;
+        float horizontalVelocity, verticalVelocity;
+
+        // Iterate over each column of the Tetrimino to find the bottom edge
+        for (int j = 0; j < 4; ++j) {
+            bottomRow = -1;
+    
+            for (int i = 0; i < 4; ++i) {
+                rotatedIndex = getRotatedIndex(piece.type, i, j, piece.rotation);
+                if (tetriminoShapes[piece.type][rotatedIndex] != 0) {
+                    bottomRow = i;  // Keep track of the bottom-most row for this column
+                }
+            }
+    
+            // If a bottom block is found, generate particles
+            if (bottomRow != -1) {
+                blockX = piece.x + j;
+                blockY = piece.y + bottomRow;
+    
+                // Create several particles falling from this block
+                for (int p = 0; p < particleCount; ++p) {  // Adjust this number to control particle count
+                    // Generate horizontal and vertical velocities, clamped between min and max
+                    horizontalVelocity = std::clamp((rand() % 100 / 50.0f - 1.0f) * velocityFactor, -maxHorizontalVelocity, maxHorizontalVelocity);
+                    verticalVelocity = std::clamp((rand() % 100 / 50.0f) * (2.0f * velocityFactor), minVelocity, maxVerticalVelocity);
+    
+                    particle = {
+                        static_cast<float>(blockX * _w + rand() % _w),  // X-position within the block
+                        static_cast<float>(blockY * _h + _h),           // Y-position at the bottom of the block
+                        horizontalVelocity,                             // Clamped horizontal velocity
+                        verticalVelocity,                               // Clamped downward velocity
+                        lifespanFactor,                                 // Lifespan based on drop distance, clamped between 0.2 and 0.6
+                        1.0f                                            // Alpha (fully visible)
+                    };
+                    spawnParticle(particle);
+                }
+            }
+        }
+    }
+
     void updateParticles(int offsetX, int offsetY) {
         std::lock_guard<std::mutex> lock(particleMutex);  // Lock when modifying the particle list
     
@@ -722,6 +733,33 @@ private:
     int level = 1;
     
 
+    // Particles beyond the cap are skipped, which bounds the cost of a busy frame
+    void spawnParticle(const Particle& particle) {
+        if (particles.size() < MAX_PARTICLES) particles.push_back(particle);
+    }
+
+    static Tetrimino pieceFromEvent(const GameEvent& event) {
+        Tetrimino piece(event.piece);
+        piece.x = event.x;
+        piece.y = event.y;
+        piece.rotation = event.rotation;
+        return piece;
+    }
+
+    void showBanner(const GameEvent& event) {
+        if (event.perfectClear) {
+            linesClearedText = "Perfect\nClear";
+        } else if (event.banner == BANNER_TETRIS && event.backToBack) {
+            linesClearedText = std::to_string(event.value) + "x Tetris";
+        } else {
+            linesClearedText = CLEAR_BANNER_TEXT[event.banner];
+        }
+        linesClearedScore = event.points;
+        showText = true;
+        fadeAlpha = 0.0f;  // Start fade animation
+        textStartTime = std::chrono::steady_clock::now();  // Track animation start time
+    }
+
     void drawParticles(tsl::gfx::Renderer* renderer, int offsetX, int offsetY) {
         tsl::Color particleColor(0);
         int particleDrawX, particleDrawY;
@@ -806,7 +844,32 @@ private:
         }
     }
 
+    // Draw a hint as hollow outlines so it reads differently from the ghost piece
+    void drawHintTetrimino(tsl::gfx::Renderer* renderer, const Tetrimino& tet, int offsetX, int offsetY) {
+        tsl::Color color = tetriminoColors[tet.type];
+        color.a = 0xC;
+        int thickness = 2;
+        int rotatedIndex;
+        int x, y;
+
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                rotatedIndex = getRotatedIndex(tet.type, i, j, tet.rotation);
+                if (rotatedIndex < 0 || tetriminoShapes[tet.type][rotatedIndex] == 0 || tet.y + i < 0) continue;
+
+                x = offsetX + (tet.x + j) * _w;
+                y = offsetY + (tet.y + i) * _h;
+                renderer->drawRect(x, y, _w, thickness, color);
+                renderer->drawRect(x, y + _h - thickness, _w, thickness, color);
+                renderer->drawRect(x, y, thickness, _h, color);
+                renderer->drawRect(x + _w - thickness, y, thickness, _h, color);
+            }
+        }
+    }
+
     void drawTetrimino(tsl::gfx::Renderer* renderer, const Tetrimino& tet, int offsetX, int offsetY) {
+        if (tet.type < 0) return; // No piece in play during line-clear and entry delay
+
         // Calculate the drop position for the ghost piece
         Tetrimino ghostTetrimino = tet;
         int dropDistance = calculateDropDistance(ghostTetrimino, *board);
@@ -957,6 +1020,10 @@ private:
 
 bool TetrisElement::paused = false;
 uint64_t TetrisElement::maxHighScore = 0; // Initialize the max high score
+bool TetrisElement::showHint = false;
+std::string TetrisElement::autoplayLabel;
+std::string TetrisElement::replayLabel;
+std::string TetrisElement::handlingLabel;
 
 
 class CustomOverlayFrame : public tsl::elm::OverlayFrame {
@@ -1100,6 +1167,52 @@ public:
 };
 
 
+const std::string SAVE_STATE_PATH = "sdmc:/config/tetris/save_state.bin";
+const std::string LEGACY_SAVE_STATE_PATH = "sdmc:/config/tetris/save_state.json";
+const std::string JSON_EXPORT_PATH = "sdmc:/config/tetris/save_state_export.json";
+const std::string REPLAY_DIRECTORY = "sdmc:/config/tetris/replays/";
+const std::string SEARCH_WEIGHTS_PATH = "sdmc:/config/tetris/weights.bin"; // Written by tools/tuner
+const std::string HANDLING_PATH = "sdmc:/config/tetris/handling.json"; // Optional handling profiles
+const std::chrono::milliseconds AUTOSAVE_INTERVAL(5000); // Minimum spacing of routine autosaves
+const std::chrono::milliseconds IO_SHUTDOWN_TIMEOUT(1000); // Longest the overlay waits for pending writes on exit
+const std::chrono::milliseconds SEARCH_BUDGET(50); // Deadline for one hint or autoplay search on the worker thread
+const std::array<int, 5> AUTOPLAY_SPEEDS = {{1, 2, 4, 10, 0}}; // Pieces per second; 0 plays as fast as the search allows
+const std::chrono::milliseconds AUTOPLAY_RESTART_DELAY(1000); // How long the bot looks at a game over before restarting
+const int AUTOPLAY_MAX_SUBFRAMES = 64; // Input frames one overlay frame may run at full speed
+
+#ifndef SAVE_JSON_EXPORT_DIRECTIVE
+#define SAVE_JSON_EXPORT_DIRECTIVE 0
+#endif
+
+// Buttons the game reacts to, in replay mask order
+const std::array<std::pair<u64, uint8_t>, 8> replayButtons = {{
+    {KEY_LEFT, REPLAY_LEFT},
+    {KEY_RIGHT, REPLAY_RIGHT},
+    {KEY_DOWN, REPLAY_DOWN},
+    {KEY_UP, REPLAY_UP},
+    {KEY_A, REPLAY_A},
+    {KEY_B, REPLAY_B},
+    {KEY_L, REPLAY_L},
+    {KEY_PLUS, REPLAY_PLUS}
+}};
+
+uint8_t toReplayMask(u64 keys) {
+    uint8_t mask = 0;
+    for (const auto& button : replayButtons) {
+        if (keys & button.first) mask |= button.second;
+    }
+    return mask;
+}
+
+u64 fromReplayMask(uint8_t mask) {
+    u64 keys = 0;
+    for (const auto& button : replayButtons) {
+        if (mask & button.second) keys |= button.first;
+    }
+    return keys;
+}
+
+
 class TetrisGui : public tsl::Gui {
 public:
     Tetrimino storedTetrimino{-1}; // -1 indicates no stored Tetrimino
@@ -1110,7 +1223,6 @@ public:
 
     // Variables to track time of last rotation or movement
     std::chrono::time_point<std::chrono::steady_clock> lastRotationOrMoveTime;
-    const std::chrono::milliseconds lockDelayExtension = std::chrono::milliseconds(500); // 500ms extension
 
     TetrisGui() : board(), currentTetrimino(rand() % 7), nextTetrimino(rand() % 7), 
                   nextTetrimino1(rand() % 7), nextTetrimino2(rand() % 7) {
@@ -1118,14 +1230,18 @@ public:
         std::srand(std::time(0));
         _w = 20;
         _h = _w;
-        lockDelayTime = std::chrono::milliseconds(500); // Set lock delay to 500ms
         lockDelayCounter = std::chrono::milliseconds(0);
     
         // Initial fall speed (1000 ms = 1 second)
         initialFallSpeed = std::chrono::milliseconds(500);
         fallCounter = std::chrono::milliseconds(0);
     
-        lastRotationOrMoveTime = std::chrono::steady_clock::now();  // Initialize with current time
+        // Start the frame clock; game logic only ever reads the quantized frame time
+        clockOrigin = std::chrono::steady_clock::now();
+        frameTime = clockOrigin;
+        frameDeltaMs = 0;
+
+        lastRotationOrMoveTime = frameTime;  // Initialize with current time
     }
 
     virtual tsl::elm::Element* createUI() override {
@@ -1133,9 +1249,18 @@ public:
         auto rootFrame = new CustomOverlayFrame("Tetris", APP_VERSION);
         tetrisElement = new TetrisElement(_w, _h, &board, &currentTetrimino, &nextTetrimino, &storedTetrimino, &nextTetrimino1, &nextTetrimino2);
         rootFrame->setContent(tetrisElement);
-        timeSinceLastFrame = std::chrono::steady_clock::now();
+        timeSinceLastFrame = frameTime;
+        loadSearchWeights();
+        loadHandlingProfiles();
     
-        loadGameState();
+        // Without a save to resume, start a fresh (recorded) game
+        if (!loadGameState()) {
+            startNewGame(makeSeed());
+        } else {
+            startRecordingFromCurrentState();
+        }
+        lastAutosavePiece = piecesSpawned;
+        lastAutosavePaused = TetrisElement::paused;
         return rootFrame;
     }
 
@@ -1143,9 +1268,99 @@ public:
 
 
 
-    virtual void update() override {
+    // Game logic advances from handleInput so that every simulated frame is also a
+    // recorded replay frame; see stepFrame()
+    virtual void update() override {}
+
+    // Advance the phase machine on the frame clock: count down the line-clear and entry
+    // delays, then let gravity and lock delay work on the piece in play
+    void stepPhase() {
+        GamePhase current = currentPhase();
+        if (current == PHASE_PAUSED || current == PHASE_TOP_OUT) return;
+
+        if (phase == PHASE_LINE_CLEAR && frameTime >= phaseDeadline) {
+            phase = PHASE_ENTRY;
+            phaseDeadline += std::chrono::milliseconds(handling.areMs);
+        }
+        if (phase == PHASE_ENTRY && frameTime >= phaseDeadline) {
+            spawnFromEntry();
+        }
+        if (!pieceInPlay()) {
+            timeSinceLastFrame = frameTime;
+            return;
+        }
+        stepGravity();
+    }
+
+    GamePhase currentPhase() const {
+        if (tetrisElement->gameOver) return PHASE_TOP_OUT;
+        if (TetrisElement::paused) return PHASE_PAUSED;
+        return phase;
+    }
+
+    bool pieceInPlay() const {
+        return phase == PHASE_FALLING || phase == PHASE_LOCKING;
+    }
+
+    // Falling or Locking, by whether the piece in play rests on the stack
+    void updatePiecePhase() {
+        if (pieceInPlay() && !tetrisElement->gameOver) phase = isOnFloor() ? PHASE_LOCKING : PHASE_FALLING;
+    }
+
+    // Lock the piece in play and clear lines. The next piece appears after the line-clear
+    // and entry delays, or in this same frame when the handling has none.
+    void lockPiece() {
+        placeTetrimino();
+        int lines = clearLines();
+
+        int lineClearDelayMs = (lines > 0) ? handling.lineClearDelayMs : 0;
+        if (tetrisElement->gameOver || lineClearDelayMs + handling.areMs == 0) {
+            spawnNewTetrimino();
+            return;
+        }
+        phase = (lineClearDelayMs > 0) ? PHASE_LINE_CLEAR : PHASE_ENTRY;
+        phaseDeadline = frameTime + std::chrono::milliseconds(lineClearDelayMs > 0 ? lineClearDelayMs : handling.areMs);
+        entryInput = 0;
+        currentTetrimino = Tetrimino(-1);
+        invalidateSearch();
+    }
+
+    // Keep rotate and hold presses made while no piece is in play (IRS/IHS)
+    void bufferEntryInput(u64 keysDown) {
+        if (keysDown & KEY_A) entryInput = (entryInput & ~ENTRY_ROTATE_CCW) | ENTRY_ROTATE_CW;
+        else if (keysDown & KEY_B) entryInput = (entryInput & ~ENTRY_ROTATE_CW) | ENTRY_ROTATE_CCW;
+        if (keysDown & KEY_L) entryInput |= ENTRY_HOLD;
+    }
+
+    // The entry delay is over: bring in the next piece and apply the kept presses to it
+    void spawnFromEntry() {
+        uint8_t pending = entryInput;
+        entryInput = 0;
+        fallCounter = std::chrono::milliseconds(0);
+        lockDelayCounter = std::chrono::milliseconds(0);
+        lastRotationOrMoveTime = frameTime;
+        timeSinceLastFrame = frameTime;
+
+        spawnNewTetrimino();
+        if (tetrisElement->gameOver) return;
+
+        if ((pending & ENTRY_HOLD) && !hasSwapped) {
+            swapStoredTetrimino();
+            hasSwapped = true;
+        }
+        if (pending & ENTRY_ROTATE_CW) {
+            finesse.countInput();
+            rotate();
+        } else if (pending & ENTRY_ROTATE_CCW) {
+            finesse.countInput();
+            rotateCounterclockwise();
+        }
+        updatePiecePhase();
+    }
+
+    void stepGravity() {
         if (!TetrisElement::paused && !tetrisElement->gameOver) {
-            auto currentTime = std::chrono::steady_clock::now();
+            auto currentTime = frameTime;
             auto elapsed = currentTime - timeSinceLastFrame;
 
             // Handle piece falling
@@ -1155,14 +1370,13 @@ public:
                 if (!move(0, 1)) { // Move down failed, piece touched the ground
                     lockDelayCounter += fallCounter; // Add elapsed time to lock delay counter
 
-                    // Check if more than 500ms has passed since the last move/rotation
+                    // Check if the lock extension has passed since the last move/rotation
                     auto timeSinceLastRotationOrMove = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastRotationOrMoveTime);
 
-                    if (lockDelayCounter >= lockDelayTime && timeSinceLastRotationOrMove >= lockDelayExtension) {
+                    if (lockDelayCounter >= std::chrono::milliseconds(handling.lockDelayMs) &&
+                        timeSinceLastRotationOrMove >= std::chrono::milliseconds(handling.lockExtensionMs)) {
                         // Lock the piece after the lock delay has passed and no rotation occurred recently
-                        placeTetrimino();
-                        clearLines();
-                        spawnNewTetrimino();
+                        lockPiece();
                         lockDelayCounter = std::chrono::milliseconds(0); // Reset the lock delay counter
                     }
                 } else {
@@ -1179,19 +1393,57 @@ public:
     
 
     void resetGame() {
-        // Create an explosion effect before resetting the game
-        createCenterExplosionParticles();
-    
-        // Delay the actual reset slightly to allow the explosion to be visible
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
-    
+        // A restart inside a replay marks the end of the recorded game
+        if (replayPlaying) {
+            finishPlayback();
+            return;
+        }
+
+        finishRecording();
+
+        // Let the explosion play over the old board; handleInput starts the new game once it is done
+        publish(GameEvent{EVENT_GAME_RESET});
+        resetPending = true;
+        resetDeadline = frameTime + RESET_ANIMATION_TIME;
+    }
+
+    void finishReset() {
+        resetPending = false;
+        startNewGame(makeSeed());
+    }
+
+    // Reset every piece of state the simulation depends on, so that a seed plus the
+    // recorded input frames fully determine the game
+    void newGame(uint64_t seed) {
+        gameSeed = seed;
+        pieceRng.seed(seed);
+
         isGameOver = false;
+        clearAutoplayPlan();
     
         // Reset variables related to game state
         lastWallKickApplied = false;
-        previousClearWasTetris = false;
-        previousClearWasTSpin = false;
-        backToBackCount = 1;
+        lastMoveWasRotation = false;
+        lastKickWasFar = false;
+        scoring = ScoringState();
+        pieceWasKickedUp = false;
+        linesClearedForLevelUp = 0;
+        totalSoftDropDistance = 0;
+        hardDropDistance = 0;
+        lockDelayMoves = 0;
+        piecesSpawned = 0;
+        resetFinesse();
+
+        // Reset timers and handling state
+        lockDelayCounter = std::chrono::milliseconds(0);
+        fallCounter = std::chrono::milliseconds(0);
+        lastRotationOrMoveTime = frameTime;
+        timeSinceLastFrame = frameTime;
+        leftShift = rightShift = downShift = AutoShift();
+        shiftRightFirst = false;
+        phase = PHASE_FALLING;
+        phaseDeadline = frameTime;
+        entryInput = 0;
     
         // Clear the board
         for (auto& row : board) {
@@ -1199,10 +1451,10 @@ public:
         }
     
         // Reset tetriminos
+        nextTetrimino = Tetrimino(pieceRng.next());
+        nextTetrimino1 = Tetrimino(pieceRng.next());
+        nextTetrimino2 = Tetrimino(pieceRng.next());
         spawnNewTetrimino();  // Spawn the first piece here
-        nextTetrimino = Tetrimino(rand() % 7);
-        nextTetrimino1 = Tetrimino(rand() % 7);
-        nextTetrimino2 = Tetrimino(rand() % 7);
     
         // Reset the stored tetrimino
         storedTetrimino = Tetrimino(-1); // Reset stored piece to no stored state
@@ -1222,9 +1474,171 @@ public:
         TetrisElement::paused = false;
     }
 
+    // A new game picks up the selected handling profile; its keyframe 0 carries it into the replay
+    void startNewGame(uint64_t seed) {
+        handling = handlingProfiles[selectedHandling].settings;
+        updateHandlingLabel();
+        newGame(seed);
+        replayRecorder.start(seed);
+        replayRecorder.addKeyframe(piecesSpawned, encodeSaveState(captureSnapshot(), 0));
+        recordingStartPiece = piecesSpawned;
+        nextKeyframePiece = piecesSpawned + REPLAY_KEYFRAME_INTERVAL;
+    }
+
+    // Record from whatever state the engine is in (e.g. a resumed save), anchored by keyframe 0
+    void startRecordingFromCurrentState() {
+        replayRecorder.start(gameSeed, REPLAY_FLAG_INITIAL_KEYFRAME);
+        replayRecorder.addKeyframe(piecesSpawned, encodeSaveState(captureSnapshot(), 0));
+        recordingStartPiece = piecesSpawned;
+        nextKeyframePiece = piecesSpawned + REPLAY_KEYFRAME_INTERVAL;
+    }
+
+    GameSnapshot captureSnapshot() {
+        GameSnapshot snapshot{};
+        auto relativeMs = [this](const std::chrono::time_point<std::chrono::steady_clock>& t) {
+            return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t - frameTime).count());
+        };
+
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            for (int x = 0; x < BOARD_WIDTH; ++x) {
+                snapshot.board[y][x] = static_cast<int8_t>(board[y][x]);
+            }
+        }
+        const Tetrimino* pieces[5] = {&currentTetrimino, &nextTetrimino, &nextTetrimino1, &nextTetrimino2, &storedTetrimino};
+        for (int i = 0; i < 5; ++i) {
+            snapshot.pieces[i] = {static_cast<int8_t>(pieces[i]->type), static_cast<int8_t>(pieces[i]->x),
+                                  static_cast<int8_t>(pieces[i]->y), static_cast<int8_t>(pieces[i]->rotation)};
+        }
+
+        snapshot.rngState = pieceRng.state;
+        snapshot.seed = gameSeed;
+        snapshot.score = tetrisElement->getScore();
+        snapshot.linesCleared = tetrisElement->getLinesCleared();
+        snapshot.level = tetrisElement->getLevel();
+        snapshot.linesClearedForLevelUp = linesClearedForLevelUp;
+        snapshot.backToBackCount = scoring.backToBackCount;
+        snapshot.combo = scoring.combo;
+        snapshot.handling = handling;
+        snapshot.phase = phase;
+        snapshot.phaseDeadlineMs = relativeMs(phaseDeadline);
+        snapshot.entryInput = entryInput;
+        snapshot.lockDelayMoves = lockDelayMoves;
+        snapshot.totalSoftDropDistance = totalSoftDropDistance;
+        snapshot.hardDropDistance = hardDropDistance;
+        snapshot.piecesSpawned = piecesSpawned;
+        snapshot.lockDelayCounterMs = lockDelayCounter.count();
+        snapshot.fallCounterMs = fallCounter.count();
+        snapshot.lastRotationOrMoveMs = relativeMs(lastRotationOrMoveTime);
+        snapshot.lastFrameMs = relativeMs(timeSinceLastFrame);
+        snapshot.lastLeftMoveMs = relativeMs(leftShift.last);
+        snapshot.lastRightMoveMs = relativeMs(rightShift.last);
+        snapshot.lastDownMoveMs = relativeMs(downShift.last);
+
+        snapshot.flags = (TetrisElement::paused ? SNAPSHOT_PAUSED : 0) |
+                         (tetrisElement->gameOver ? SNAPSHOT_GAME_OVER : 0) |
+                         (hasSwapped ? SNAPSHOT_HAS_SWAPPED : 0) |
+                         (lastWallKickApplied ? SNAPSHOT_WALL_KICK : 0) |
+                         (lastMoveWasRotation ? SNAPSHOT_ROTATED_LAST : 0) |
+                         (lastKickWasFar ? SNAPSHOT_FAR_KICK : 0) |
+                         (scoring.previousClearWasTetris ? SNAPSHOT_PREV_TETRIS : 0) |
+                         (scoring.previousClearWasTSpin ? SNAPSHOT_PREV_TSPIN : 0) |
+                         (pieceWasKickedUp ? SNAPSHOT_KICKED_UP : 0) |
+                         (leftShift.held ? SNAPSHOT_LEFT_HELD : 0) |
+                         (rightShift.held ? SNAPSHOT_RIGHT_HELD : 0) |
+                         (downShift.held ? SNAPSHOT_DOWN_HELD : 0) |
+                         (leftShift.repeating ? SNAPSHOT_LEFT_ARR : 0) |
+                         (rightShift.repeating ? SNAPSHOT_RIGHT_ARR : 0) |
+                         (downShift.repeating ? SNAPSHOT_DOWN_ARR : 0) |
+                         (shiftRightFirst ? SNAPSHOT_RIGHT_PRIORITY : 0);
+
+        return snapshot;
+    }
+
+    void restoreSnapshot(const GameSnapshot& snapshot) {
+        auto absoluteTime = [this](int64_t ms) { return frameTime + std::chrono::milliseconds(ms); };
+
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            for (int x = 0; x < BOARD_WIDTH; ++x) {
+                board[y][x] = snapshot.board[y][x];
+            }
+        }
+        Tetrimino* pieces[5] = {&currentTetrimino, &nextTetrimino, &nextTetrimino1, &nextTetrimino2, &storedTetrimino};
+        for (int i = 0; i < 5; ++i) {
+            pieces[i]->type = snapshot.pieces[i][0];
+            pieces[i]->x = snapshot.pieces[i][1];
+            pieces[i]->y = snapshot.pieces[i][2];
+            pieces[i]->rotation = snapshot.pieces[i][3];
+        }
+
+        pieceRng.state = snapshot.rngState;
+        gameSeed = snapshot.seed;
+        tetrisElement->setScore(snapshot.score);
+        tetrisElement->setLinesCleared(snapshot.linesCleared);
+        tetrisElement->setLevel(snapshot.level);
+        linesClearedForLevelUp = snapshot.linesClearedForLevelUp;
+        scoring.backToBackCount = snapshot.backToBackCount;
+        scoring.combo = snapshot.combo;
+        handling = snapshot.handling;
+        phase = static_cast<GamePhase>(snapshot.phase);
+        phaseDeadline = absoluteTime(snapshot.phaseDeadlineMs);
+        entryInput = snapshot.entryInput;
+        lockDelayMoves = snapshot.lockDelayMoves;
+        totalSoftDropDistance = snapshot.totalSoftDropDistance;
+        hardDropDistance = snapshot.hardDropDistance;
+        piecesSpawned = snapshot.piecesSpawned;
+        lockDelayCounter = std::chrono::milliseconds(snapshot.lockDelayCounterMs);
+        fallCounter = std::chrono::milliseconds(snapshot.fallCounterMs);
+        lastRotationOrMoveTime = absoluteTime(snapshot.lastRotationOrMoveMs);
+        timeSinceLastFrame = absoluteTime(snapshot.lastFrameMs);
+        leftShift.last = absoluteTime(snapshot.lastLeftMoveMs);
+        rightShift.last = absoluteTime(snapshot.lastRightMoveMs);
+        downShift.last = absoluteTime(snapshot.lastDownMoveMs);
+
+        TetrisElement::paused = snapshot.flags & SNAPSHOT_PAUSED;
+        tetrisElement->gameOver = snapshot.flags & SNAPSHOT_GAME_OVER;
+        isGameOver = tetrisElement->gameOver;
+        hasSwapped = snapshot.flags & SNAPSHOT_HAS_SWAPPED;
+        lastWallKickApplied = snapshot.flags & SNAPSHOT_WALL_KICK;
+        lastMoveWasRotation = snapshot.flags & SNAPSHOT_ROTATED_LAST;
+        lastKickWasFar = snapshot.flags & SNAPSHOT_FAR_KICK;
+        scoring.previousClearWasTetris = snapshot.flags & SNAPSHOT_PREV_TETRIS;
+        scoring.previousClearWasTSpin = snapshot.flags & SNAPSHOT_PREV_TSPIN;
+        pieceWasKickedUp = snapshot.flags & SNAPSHOT_KICKED_UP;
+        leftShift.held = snapshot.flags & SNAPSHOT_LEFT_HELD;
+        rightShift.held = snapshot.flags & SNAPSHOT_RIGHT_HELD;
+        downShift.held = snapshot.flags & SNAPSHOT_DOWN_HELD;
+        leftShift.repeating = snapshot.flags & SNAPSHOT_LEFT_ARR;
+        rightShift.repeating = snapshot.flags & SNAPSHOT_RIGHT_ARR;
+        downShift.repeating = snapshot.flags & SNAPSHOT_DOWN_ARR;
+        shiftRightFirst = snapshot.flags & SNAPSHOT_RIGHT_PRIORITY;
+        updateHandlingLabel();
+
+        // Presses made before the snapshot are unknown, so judging starts with the next piece
+        resetFinesse();
+        clearAutoplayPlan();
+        invalidateSearch();
+    }
+
+    // Decode and apply a keyframe or save record
+    bool restoreSaveRecord(const std::vector<uint8_t>& record, uint64_t* maxHighScore = nullptr) {
+        GameSnapshot snapshot;
+        uint64_t storedHighScore;
+        if (!decodeSaveState(record.data(), record.size(), snapshot, storedHighScore)) return false;
+        restoreSnapshot(snapshot);
+        if (maxHighScore) *maxHighScore = storedHighScore;
+        return true;
+    }
+
+    static uint64_t makeSeed() {
+        uint64_t seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        return seed ^ (static_cast<uint64_t>(std::time(0)) << 32);
+    }
+
 
     
     void swapStoredTetrimino() {
+        invalidateSearch();
+
         if (storedTetrimino.type == -1) {
             // No stored Tetrimino, store the current one and spawn a new one
             storedTetrimino = currentTetrimino;
@@ -1238,98 +1652,148 @@ public:
             currentTetrimino.rotation = 0;  // Reset the swapped piece's rotation to default
             storedTetrimino.rotation = 0;  // Reset the stored piece's rotation to default
         }
+        lastMoveWasRotation = false;
+        finesse.startPiece(currentTetrimino);
     }
 
-    void createImpactParticles(int dropDistance) {
-        std::lock_guard<std::mutex> lock(particleMutex);  // Lock to ensure safe access to the particle list
+    void hardDrop() {
+        // Calculate how far the piece will fall
+        hardDropDistance = calculateDropDistance(currentTetrimino, board);
+        currentTetrimino.y += hardDropDistance;
         
-        // Cap the maximum drop distance to avoid excessive velocity
-        float velocityFactor = std::min(dropDistance / 10.0f, 2.0f);  // Adjust the divisor and cap for desired effect
+        // Award points for hard drop (e.g., 2 points per row)
+        int hardDropScore = hardDropDistance * 2;
+        tetrisElement->setScore(tetrisElement->getScore() + hardDropScore);
         
-        // Set minimum and maximum horizontal and vertical velocities
-        float minVelocity = 0.5f;  // Minimum velocity value
-        float maxHorizontalVelocity = 2.0f * velocityFactor;
-        float maxVerticalVelocity = 4.0f * velocityFactor;
-        
-        // Calculate lifespan based on drop distance with a minimum of 0.2 and a maximum of 0.6
-        float lifespanFactor = std::clamp(dropDistance / 20.0f, 0.2f, 0.6f);
+        GameEvent drop = pieceEvent(EVENT_HARD_DROP);
+        drop.value = hardDropDistance;
+        publish(drop);
+
+        // Place the piece and reset drop distance trackers
+        lockPiece();
+    
+        // Reset distances after placing
+        totalSoftDropDistance = 0;
+        hardDropDistance = 0;
         
-        // Calculate the number of particles based on drop distance, clamped between 2 and 5 particles
-        int particleCount = std::clamp(2 + dropDistance / 5, 2, 5);
+        if (pieceInPlay() && !isPositionValid(currentTetrimino, board)) {
+            topOut();
+        }
+    }
 
-        int bottomRow;
-        int rotatedIndex;
-        int blockX, blockY;
-        Particle particle;
-        float horizontalVelocity, verticalVelocity;
 
-        // Iterate over each column of the Tetrimino to find the bottom edge
-        for (int j = 0; j < 4; ++j) {
-            bottomRow = -1;
-    
-            for (int i = 0; i < 4; ++i) {
-                rotatedIndex = getRotatedIndex(currentTetrimino.type, i, j, currentTetrimino.rotation);
-                if (tetriminoShapes[currentTetrimino.type][rotatedIndex] != 0) {
-                    bottomRow = i;  // Keep track of the bottom-most row for this column
-                }
-            }
-    
-            // If a bottom block is found, generate particles
-            if (bottomRow != -1) {
-                blockX = currentTetrimino.x + j;
-                blockY = currentTetrimino.y + bottomRow;
-    
-                // Create several particles falling from this block
-                for (int p = 0; p < particleCount; ++p) {  // Adjust this number to control particle count
-                    // Generate horizontal and vertical velocities, clamped between min and max
-                    horizontalVelocity = std::clamp((rand() % 100 / 50.0f - 1.0f) * velocityFactor, -maxHorizontalVelocity, maxHorizontalVelocity);
-                    verticalVelocity = std::clamp((rand() % 100 / 50.0f) * (2.0f * velocityFactor), minVelocity, maxVerticalVelocity);
-    
-                    particle = {
-                        static_cast<float>(blockX * _w + rand() % _w),  // X-position within the block
-                        static_cast<float>(blockY * _h + _h),           // Y-position at the bottom of the block
-                        horizontalVelocity,                             // Clamped horizontal velocity
-                        verticalVelocity,                               // Clamped downward velocity
-                        lifespanFactor,                                 // Lifespan based on drop distance, clamped between 0.2 and 0.6
-                        1.0f                                            // Alpha (fully visible)
-                    };
-                    particles.push_back(particle);
-                }
+
+
+    // Hand a snapshot to the I/O worker; it is encoded and written in the background
+    void saveGameState(bool urgent = true) {
+        if (replayPlaying) return; // The live game is parked in memory during playback
+
+        // A restored save always comes back paused, however it was written
+        GameSnapshot snapshot = captureSnapshot();
+        snapshot.flags |= SNAPSHOT_PAUSED;
+        uint64_t highScore = TetrisElement::maxHighScore;
+        ioWorker.submit(SAVE_STATE_PATH, [snapshot, highScore]() {
+            return encodeSaveState(snapshot, highScore);
+        }, urgent, AUTOSAVE_INTERVAL);
+
+    #if SAVE_JSON_EXPORT_DIRECTIVE
+        exportGameStateJson();
+    #endif
+    }
+
+    bool loadGameState() {
+        std::vector<uint8_t> record;
+        GameSnapshot snapshot;
+        uint64_t storedHighScore = 0;
+        auto isValid = [&](const std::vector<uint8_t>& data) {
+            return decodeSaveState(data.data(), data.size(), snapshot, storedHighScore);
+        };
+
+        if (!readFileWithFallback(SAVE_STATE_PATH, record, isValid)) {
+            // Migrate saves written before the binary format existed. The binary save is
+            // written right here and the JSON only goes once it is safely on the card.
+            if (!loadLegacyGameState()) return false;
+            GameSnapshot migrated = captureSnapshot();
+            migrated.flags |= SNAPSHOT_PAUSED;
+            if (writeFileAtomically(SAVE_STATE_PATH, encodeSaveState(migrated, TetrisElement::maxHighScore))) {
+                std::remove(LEGACY_SAVE_STATE_PATH.c_str());
             }
+            return true;
         }
+
+        restoreSnapshot(snapshot);
+        TetrisElement::maxHighScore = std::max(TetrisElement::maxHighScore, storedHighScore);
+        return true;
     }
 
+    // Tuned evaluator weights for hints and autoplay; the defaults stay if the file is missing or damaged.
+    // Runs before the first search is submitted, so the worker is idle.
+    void loadSearchWeights() {
+        std::vector<uint8_t> data;
+        EvalWeights weights = searchWorker.searcher().weights;
+        auto isValid = [&](const std::vector<uint8_t>& contents) {
+            return decodeWeights(contents.data(), contents.size(), weights);
+        };
+        if (readFileWithFallback(SEARCH_WEIGHTS_PATH, data, isValid)) {
+            searchWorker.searcher().weights = weights;
+        }
+    }
 
+    // Built-in profiles plus those in handling.json, parsed once; a profile named like a
+    // built-in one replaces it and any field it leaves out keeps the Classic value
+    void loadHandlingProfiles() {
+        handlingProfileCount = 0;
+        for (const auto& profile : BUILT_IN_HANDLING) handlingProfiles[handlingProfileCount++] = profile;
+        selectedHandling = 0;
+
+        json_t* root = readJsonFromFile(HANDLING_PATH);
+        if (root) {
+            json_t* profiles = json_object_get(root, "profiles");
+            for (size_t i = 0; i < json_array_size(profiles); ++i) {
+                json_t* entry = json_array_get(profiles, i);
+                const char* name = json_string_value(json_object_get(entry, "name"));
+                if (!name || !*name) continue;
+
+                auto fields = toHandlingFields(CLASSIC_HANDLING);
+                for (size_t field = 0; field < HANDLING_FIELD_COUNT; ++field) {
+                    json_t* value = json_object_get(entry, HANDLING_FIELD_NAMES[field]);
+                    if (json_is_integer(value)) {
+                        fields[field] = static_cast<uint16_t>(std::clamp<json_int_t>(json_integer_value(value), 0, 10000));
+                    }
+                }
 
-    void hardDrop() {
-        // Calculate how far the piece will fall
-        hardDropDistance = calculateDropDistance(currentTetrimino, board);
-        currentTetrimino.y += hardDropDistance;
-        
-        // Award points for hard drop (e.g., 2 points per row)
-        int hardDropScore = hardDropDistance * 2;
-        tetrisElement->setScore(tetrisElement->getScore() + hardDropScore);
-        
-        createImpactParticles(hardDropDistance);
+                size_t slot = findHandlingProfile(name);
+                if (slot == handlingProfileCount) {
+                    if (handlingProfileCount == MAX_HANDLING_PROFILES) continue;
+                    handlingProfileCount++;
+                }
+                std::snprintf(handlingProfiles[slot].name, HANDLING_NAME_SIZE, "%s", name);
+                handlingProfiles[slot].settings = fromHandlingFields(fields);
+            }
 
-        // Place the piece and reset drop distance trackers
-        placeTetrimino();
-        clearLines();
-        spawnNewTetrimino();
-    
-        // Reset distances after placing
-        totalSoftDropDistance = 0;
-        hardDropDistance = 0;
-        
-        if (!isPositionValid(currentTetrimino, board)) {
-            tetrisElement->gameOver = true;
+            const char* active = json_string_value(json_object_get(root, "active"));
+            if (active && findHandlingProfile(active) < handlingProfileCount) selectedHandling = findHandlingProfile(active);
+            json_decref(root);
         }
+        updateHandlingLabel();
     }
 
+    // Index of the profile with this name (compared as stored), or handlingProfileCount
+    size_t findHandlingProfile(const char* name) const {
+        for (size_t i = 0; i < handlingProfileCount; ++i) {
+            if (std::strncmp(handlingProfiles[i].name, name, HANDLING_NAME_SIZE - 1) == 0) return i;
+        }
+        return handlingProfileCount;
+    }
 
+    void updateHandlingLabel() {
+        TetrisElement::handlingLabel = std::string("Handling: ") + handlingProfiles[selectedHandling].name;
+        const auto current = toHandlingFields(handling), selected = toHandlingFields(handlingProfiles[selectedHandling].settings);
+        if (current != selected) TetrisElement::handlingLabel += " (next game)";
+    }
 
-
-    void saveGameState() {
+    // Human-readable dump of the game state, for debugging only
+    void exportGameStateJson() {
         json_t* root = json_object();
     
         // Save general game state
@@ -1343,9 +1807,9 @@ public:
     
         // Save additional variables
         json_object_set_new(root, "lastWallKickApplied", json_boolean(lastWallKickApplied));  // New
-        json_object_set_new(root, "previousClearWasTetris", json_boolean(previousClearWasTetris));  // New
-        json_object_set_new(root, "previousClearWasTSpin", json_boolean(previousClearWasTSpin));  // New
-        json_object_set_new(root, "backToBackCount", json_integer(backToBackCount));  // New
+        json_object_set_new(root, "previousClearWasTetris", json_boolean(scoring.previousClearWasTetris));  // New
+        json_object_set_new(root, "previousClearWasTSpin", json_boolean(scoring.previousClearWasTSpin));  // New
+        json_object_set_new(root, "backToBackCount", json_integer(scoring.backToBackCount));  // New
 
         // Save current Tetrimino
         json_t* currentTetriminoJson = json_object();
@@ -1388,7 +1852,7 @@ public:
         json_object_set_new(root, "board", boardJson);
     
         // Write to the file
-        std::ofstream file("sdmc:/config/tetris/save_state.json");
+        std::ofstream file(JSON_EXPORT_PATH);
         if (file.is_open()) {
             char* jsonString = json_dumps(root, JSON_INDENT(4));
             file << jsonString;
@@ -1399,10 +1863,14 @@ public:
         json_decref(root);
     }
 
-    void loadGameState() {
-        json_t* root = readJsonFromFile("sdmc:/config/tetris/save_state.json");
-        if (!root) return;
-        
+    bool loadLegacyGameState() {
+        json_t* root = readJsonFromFile(LEGACY_SAVE_STATE_PATH);
+        if (!root) return false;
+
+        // The JSON kept no piece generator state; give the rest of the game a fresh seed,
+        // which keyframe 0 of its replay then carries
+        gameSeed = makeSeed();
+        pieceRng.seed(gameSeed);
         
         // Load general game state
         const char* scoreStr = json_string_value(json_object_get(root, "score"));
@@ -1420,9 +1888,9 @@ public:
         
         // Load additional variables
         lastWallKickApplied = json_is_true(json_object_get(root, "lastWallKickApplied"));  // New
-        previousClearWasTetris = json_is_true(json_object_get(root, "previousClearWasTetris"));  // New
-        previousClearWasTSpin = json_is_true(json_object_get(root, "previousClearWasTSpin"));  // New
-        backToBackCount = json_integer_value(json_object_get(root, "backToBackCount"));  // New
+        scoring.previousClearWasTetris = json_is_true(json_object_get(root, "previousClearWasTetris"));  // New
+        scoring.previousClearWasTSpin = json_is_true(json_object_get(root, "previousClearWasTSpin"));  // New
+        scoring.backToBackCount = json_integer_value(json_object_get(root, "backToBackCount"));  // New
 
         // Load current Tetrimino
         json_t* currentTetriminoJson = json_object_get(root, "currentTetrimino");
@@ -1462,22 +1930,43 @@ public:
         }
     
         json_decref(root);
+        return true;
     }
 
 
-    // Define constants for DAS (Delayed Auto-Shift) and ARR (Auto-Repeat Rate)
-    const int DAS = 300;  // DAS delay in milliseconds
-    const int ARR = 40;   // ARR interval in milliseconds
+    // Handling of the game being played (DAS, ARR, soft drop, lock delay, entry delays); see handling.hpp
+    HandlingSettings handling = CLASSIC_HANDLING;
+
+    // Profiles to choose from on the pause screen; the selected one applies from the next game
+    std::array<HandlingProfile, MAX_HANDLING_PROFILES> handlingProfiles{};
+    size_t handlingProfileCount = 0;
+    size_t selectedHandling = 0;
     
     // Variables to track key hold states and timing
-    std::chrono::time_point<std::chrono::steady_clock> lastLeftMove, lastRightMove, lastDownMove;
-    bool leftHeld = false, rightHeld = false, downHeld = false;
-    bool leftARR = false, rightARR = false, downARR = false;
+    AutoShift leftShift, rightShift, downShift;
+    bool shiftRightFirst = false;  // With both directions held, the one pressed last moves
     
     bool handleInput(u64 keysDown, u64 keysHeld, touchPosition touchInput, JoystickPosition leftJoyStick, JoystickPosition rightJoyStick) override {
-        auto currentTime = std::chrono::steady_clock::now();
-        bool moved = false;
-    
+        auto inputTime = std::chrono::steady_clock::now();
+        bool handled = handleFrameInput(keysDown, keysHeld);
+        stampStateVersion(keysDown != 0 && autoplaySetting < 0 && !replayPlaying, inputTime);
+        return handled;
+    }
+
+    // Give the visible piece state a new version when this frame changed it; a press that
+    // changed it starts a latency probe that the first frame drawn with that version ends
+    void stampStateVersion(bool buttonEdge, std::chrono::steady_clock::time_point inputTime) {
+        std::array<int64_t, 8> signature = {
+            currentTetrimino.type, currentTetrimino.x, currentTetrimino.y, currentTetrimino.rotation,
+            storedTetrimino.type, piecesSpawned, TetrisElement::paused, tetrisElement->gameOver
+        };
+        if (signature == lastStateSignature) return;
+        lastStateSignature = signature;
+        tetrisElement->stateVersion = ++stateVersion;
+        if (buttonEdge) inputLatency.inputApplied(inputTime, stateVersion);
+    }
+
+    bool handleFrameInput(u64 keysDown, u64 keysHeld) {
         // Handle the rest of the input only if the game is not paused and not over
         if (simulatedBack) {
             keysDown |= KEY_B;
@@ -1488,6 +1977,184 @@ public:
             keysDown |= KEY_A;
             simulatedSelect = false;
         }
+
+        // The reset animation runs on the frame clock; any press skips the rest of it
+        if (resetPending) {
+            advanceFrameClock();
+            if (keysDown || frameTime >= resetDeadline) finishReset();
+            return true;
+        }
+
+        if (replayPlaying) {
+            return handlePlaybackInput(keysDown);
+        }
+
+        // Watch the last recorded game from the pause screen
+        if (TetrisElement::paused && !tetrisElement->gameOver && (keysDown & KEY_Y)) {
+            startPlayback();
+            return true;
+        }
+
+        // Toggle placement hints from the pause screen
+        if (TetrisElement::paused && !tetrisElement->gameOver && (keysDown & KEY_X)) {
+            TetrisElement::showHint = !TetrisElement::showHint;
+            invalidateSearch();
+            return true;
+        }
+
+        // Pick the handling profile for the next game from the pause screen
+        if (TetrisElement::paused && !tetrisElement->gameOver && (keysDown & KEY_L)) {
+            selectedHandling = (selectedHandling + 1) % handlingProfileCount;
+            updateHandlingLabel();
+            return true;
+        }
+
+        // Cycle the autoplay bot through its speeds (and off) from the pause or game over screen
+        if ((TetrisElement::paused || tetrisElement->gameOver) && (keysDown & KEY_R)) {
+            cycleAutoplaySpeed();
+            return true;
+        }
+
+        advanceFrameClock();
+        updateSearch();
+
+        // Only the buttons the game reacts to are recorded and simulated, so live
+        // play and playback see exactly the same input
+        uint8_t heldMask = toReplayMask(keysHeld);
+        uint8_t downMask = toReplayMask(keysDown);
+        bool handled;
+        if (autoplaySetting >= 0 && !TetrisElement::paused) {
+            // The bot owns the controls; Plus still pauses
+            handled = runAutoplayFrames(heldMask & REPLAY_PLUS, downMask & REPLAY_PLUS);
+        } else {
+            handled = runFrame(frameDeltaMs, heldMask, downMask);
+        }
+        updateSearch();
+
+        // Periodic keyframes let long replays be seeked without simulating from the start
+        if (replayRecorder.isRecording() && piecesSpawned >= nextKeyframePiece) {
+            replayRecorder.addKeyframe(piecesSpawned, encodeSaveState(captureSnapshot(), 0));
+            nextKeyframePiece = piecesSpawned + REPLAY_KEYFRAME_INTERVAL;
+        }
+
+        // Autosave whenever a piece locks; the worker spaces out the actual writes
+        if (piecesSpawned != lastAutosavePiece || TetrisElement::paused != lastAutosavePaused) {
+            bool pausedNow = TetrisElement::paused && !lastAutosavePaused;
+            lastAutosavePiece = piecesSpawned;
+            lastAutosavePaused = TetrisElement::paused;
+            saveGameState(pausedNow);
+        }
+        return handled;
+    }
+
+    // Pause a game in progress through a recorded Plus frame, so playback pauses at the same
+    // point instead of running gravity and lock delay across the time the overlay was hidden
+    void pauseForHide() {
+        if (TetrisElement::paused || tetrisElement->gameOver || replayPlaying || resetPending) return;
+        advanceFrameClock();
+        runFrame(frameDeltaMs, 0, REPLAY_PLUS);
+        lastAutosavePaused = TetrisElement::paused;
+    }
+
+    // Record one frame of input and run the game on it
+    bool runFrame(uint32_t deltaMs, uint8_t heldMask, uint8_t downMask) {
+        replayRecorder.record(deltaMs, heldMask, downMask);
+        return stepFrame(fromReplayMask(downMask), fromReplayMask(heldMask));
+    }
+
+    // Play the bot's due input frames. Paced speeds run one frame per overlay frame;
+    // full speed plays a whole piece at once through zero-length frames.
+    bool runAutoplayFrames(uint8_t humanHeld, uint8_t humanDown) {
+        uint8_t buttons = 0;
+        bool due = nextAutoplayFrame(buttons);
+        bool handled = runFrame(frameDeltaMs, buttons | humanHeld, buttons | humanDown);
+
+        if (AUTOPLAY_SPEEDS[autoplaySetting] == 0) {
+            for (int frame = 1; due && frame < AUTOPLAY_MAX_SUBFRAMES && !TetrisElement::paused; ++frame) {
+                due = nextAutoplayFrame(buttons);
+                if (due) handled = runFrame(0, buttons, buttons);
+            }
+        }
+        return handled;
+    }
+
+    // Next bot input if one is due at frameTime; replans when the game no longer
+    // matches what the current plan expects
+    bool nextAutoplayFrame(uint8_t& buttons) {
+        buttons = 0;
+        if (TetrisElement::paused) return false;
+
+        if (tetrisElement->gameOver) {
+            // Restart after a short look at the final board
+            if (!autoplaySawGameOver) {
+                autoplaySawGameOver = true;
+                autoplayGameOverTime = frameTime;
+            }
+            if (frameTime - autoplayGameOverTime < AUTOPLAY_RESTART_DELAY) return false;
+            autoplaySawGameOver = false;
+            buttons = REPLAY_A;
+            return true;
+        }
+
+        int speed = AUTOPLAY_SPEEDS[autoplaySetting];
+        auto slot = std::chrono::milliseconds(speed > 0 ? 1000 / speed : 0);
+
+        if (autoplayIndex >= autoplayPlan.size()) {
+            if (!searchReady) return false; // Still searching; try again next frame
+            searchReady = false;
+            if (!buildAutoplayPlan(searchedSituation, searchResult, autoplayPlan)) {
+                invalidateSearch();
+                return false;
+            }
+            autoplayIndex = 0;
+            autoplayPieceStart = std::max(frameTime, autoplayNextPiece);
+            autoplayNextPiece = autoplayPieceStart + slot;
+        }
+
+        // Move the piece right away so gravity has little time to interfere; only the
+        // hard drop waits for the end of the piece's time slot
+        if (autoplayIndex + 1 == autoplayPlan.size() && frameTime < autoplayPieceStart + slot) return false;
+
+        const AutoplayFrame& frame = autoplayPlan[autoplayIndex];
+        if (frame.buttons && (currentTetrimino.x != frame.x || currentTetrimino.y != frame.y ||
+                              currentTetrimino.rotation != frame.rotation)) {
+            // Gravity or lock delay got there first; search again from where the piece is now
+            clearAutoplayPlan();
+            invalidateSearch();
+            return false;
+        }
+        autoplayIndex++;
+        buttons = frame.buttons;
+        return true;
+    }
+
+    void clearAutoplayPlan() {
+        autoplayPlan.clear();
+        autoplayIndex = 0;
+    }
+
+    void cycleAutoplaySpeed() {
+        autoplaySetting = (autoplaySetting + 1 < static_cast<int>(AUTOPLAY_SPEEDS.size())) ? autoplaySetting + 1 : -1;
+        clearAutoplayPlan();
+        invalidateSearch();
+        autoplaySawGameOver = false;
+        autoplayNextPiece = frameTime;
+
+        if (autoplaySetting < 0) {
+            TetrisElement::autoplayLabel.clear();
+        } else if (AUTOPLAY_SPEEDS[autoplaySetting] == 0) {
+            TetrisElement::autoplayLabel = "Bot Max";
+        } else {
+            TetrisElement::autoplayLabel = "Bot " + std::to_string(AUTOPLAY_SPEEDS[autoplaySetting]) + " PPS";
+        }
+    }
+
+    // Advance the game by one frame at frameTime
+    bool stepFrame(u64 keysDown, u64 keysHeld) {
+        auto currentTime = frameTime;
+        bool moved = false;
+
+        stepPhase();
     
         // Handle input when the game is paused or over
         if (TetrisElement::paused || tetrisElement->gameOver) {
@@ -1508,7 +2175,8 @@ public:
                 TetrisElement::paused = false;
             }
             // Allow closing the overlay with KEY_B only when paused or game over
-            if (keysDown & KEY_B) {
+            if ((keysDown & KEY_B) && !replayPlaying) {
+                finishRecording();
                 saveGameState();
                 tsl::Overlay::get()->close();
             }
@@ -1518,114 +2186,53 @@ public:
         }
     
         // Handle swapping with the stored Tetrimino
-        if (keysDown & KEY_L && !hasSwapped) {
+        if (keysDown & KEY_L && !hasSwapped && pieceInPlay()) {
             swapStoredTetrimino();
             hasSwapped = true;
         }
     
-        // Handle left movement with DAS and ARR
-        if (keysHeld & KEY_LEFT) {
-            if (!leftHeld) {
-                // First press
-                moved = move(-1, 0);
-                lastLeftMove = currentTime;
-                leftHeld = true;
-                leftARR = false; // Reset ARR phase
-            } else {
-                // DAS check
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastLeftMove).count();
-                if (!leftARR && elapsed >= DAS) {
-                    // Once DAS is reached, start ARR
-                    moved = move(-1, 0);
-                    lastLeftMove = currentTime; // Reset time for ARR phase
-                    leftARR = true;
-                } else if (leftARR && elapsed >= ARR) {
-                    // Auto-repeat after ARR interval
-                    moved = move(-1, 0);
-                    lastLeftMove = currentTime; // Keep resetting for ARR
-                }
-            }
-        } else {
-            leftHeld = false;
+        // Handle left and right movement with DAS and ARR. A new press takes over from
+        // the other direction, which waits and charges its DAS again until released.
+        bool leftDown = keysHeld & KEY_LEFT, rightDown = keysHeld & KEY_RIGHT;
+        bool leftPressed = leftDown && !leftShift.held, rightPressed = rightDown && !rightShift.held;
+        if (rightPressed) shiftRightFirst = true;
+        else if (leftPressed) shiftRightFirst = false;
+
+        AutoShiftTiming shiftTiming = {handling.dasMs, handling.arrMs};
+        if (leftDown && rightDown) {
+            if (shiftRightFirst) leftShift.suspend(currentTime);
+            else rightShift.suspend(currentTime);
         }
-    
-        // Handle right movement with DAS and ARR
-        if (keysHeld & KEY_RIGHT) {
-            if (!rightHeld) {
-                // First press
-                moved = move(1, 0);
-                lastRightMove = currentTime;
-                rightHeld = true;
-                rightARR = false; // Reset ARR phase
-            } else {
-                // DAS check
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastRightMove).count();
-                if (!rightARR && elapsed >= DAS) {
-                    // Once DAS is reached, start ARR
-                    moved = move(1, 0);
-                    lastRightMove = currentTime;
-                    rightARR = true;
-                } else if (rightARR && elapsed >= ARR) {
-                    // Auto-repeat after ARR interval
-                    moved = move(1, 0);
-                    lastRightMove = currentTime; // Keep resetting for ARR
-                }
-            }
-        } else {
-            rightHeld = false;
+        if (!(leftDown && rightDown && shiftRightFirst)) {
+            if (leftPressed) finesse.countInput();
+            moved |= shift(-1, leftShift.poll(leftDown, currentTime, shiftTiming));
         }
-    
-        // Handle down movement with DAS and ARR for soft dropping
-        if (keysHeld & KEY_DOWN) {
-            if (!downHeld) {
-                // Check if the piece is on the floor and lock it immediately
-                if (isOnFloor()) {
-                    hardDrop();
-                } else {
-                    // First press
-                    moved = move(0, 1);
-                    lastDownMove = currentTime;
-                    downHeld = true;
-                    downARR = false; // Reset ARR phase
-                }
-
-            } else {
-                // DAS check
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastDownMove).count();
-                if (!downARR && elapsed >= DAS) {
-                    if (isOnFloor()) {
-                        hardDrop();
-                    } else {
-                        // Once DAS is reached, start ARR
-                        moved = move(0, 1);
-                        lastDownMove = currentTime;
-                        downARR = true;
-                    }
-                } else if (downARR && elapsed >= ARR) {
-                    if (isOnFloor()) {
-                        hardDrop();
-                    } else {
-                        // Auto-repeat after ARR interval
-                        moved = move(0, 1);
-                        lastDownMove = currentTime;
-                    }
-                }
-            }
-
-        } else {
-            downHeld = false;
+        if (!(leftDown && rightDown && !shiftRightFirst)) {
+            if (rightPressed) finesse.countInput();
+            moved |= shift(1, rightShift.poll(rightDown, currentTime, shiftTiming));
         }
+    
+        // Handle down movement for soft dropping; a step due while the piece rests on the floor locks it
+        bool downDown = keysHeld & KEY_DOWN;
+        int softDropMs = handling.softDropFactor ? static_cast<int>(getFallSpeed().count()) / handling.softDropFactor : 0;
+        if (downDown && !downShift.held && !isOnFloor()) finesse.countInput();
+        moved |= softDrop(downShift.poll(downDown, currentTime, {softDropMs, softDropMs}));
         
         // Handle hard drop with the Up key
-        if (keysDown & KEY_UP) {
+        if ((keysDown & KEY_UP) && pieceInPlay()) {
             hardDrop();  // Perform hard drop immediately
         }
         
-        // Handle rotation inputs
-        if (keysDown & KEY_A) {
+        // Handle rotation inputs; without a piece in play they wait for the next one, and so
+        // does a hold press (the piece may also have locked earlier in this frame)
+        if (!pieceInPlay()) {
+            bufferEntryInput(keysDown);
+        } else if (keysDown & KEY_A) {
+            finesse.countInput();
             rotate(); // Rotate clockwise
             moved = true;
         } else if (keysDown & KEY_B) {
+            finesse.countInput();
             rotateCounterclockwise(); // Rotate counterclockwise
             moved = true;
         }
@@ -1639,9 +2246,234 @@ public:
         if (moved) {
             lockDelayCounter = std::chrono::milliseconds(0);
         }
+        updatePiecePhase();
         
         return false;
     }
+
+
+    // Apply steps owed by an auto-shift as one move, stopping at the first blocked one
+    bool shift(int dx, int steps) {
+        if (!pieceInPlay()) return false; // Steps owed during entry delay only charge the auto-shift
+        bool moved = false;
+        for (int i = 0; i < steps && move(dx, 0); ++i) moved = true;
+        return moved;
+    }
+
+    bool softDrop(int steps) {
+        if (!pieceInPlay()) return false;
+        bool moved = false;
+        for (int i = 0; i < steps; ++i) {
+            if (isOnFloor()) {
+                if (steps != AUTO_SHIFT_INSTANT) hardDrop();  // Instant soft drop only sonic drops
+                break;
+            }
+            moved |= move(0, 1);
+        }
+        return moved;
+    }
+
+    // The piece or hold slot changed: drop the shown hint and search again
+    void invalidateSearch() {
+        searchDirty = true;
+        searchReady = false;
+        searchWorker.cancel();
+        if (tetrisElement) {
+            tetrisElement->hintTetrimino.type = -1;
+            tetrisElement->perfectClearAvailable = false;
+        }
+    }
+
+    // Submit the current situation when it changed and pick up a finished search;
+    // neither call blocks, so a late search just shows up a frame later. Without
+    // hints or autoplay only the perfect clear indicator needs a search.
+    void updateSearch() {
+        if (TetrisElement::paused || tetrisElement->gameOver || !pieceInPlay()) return;
+        bool placementSearch = TetrisElement::showHint || autoplaySetting >= 0;
+
+        if (searchDirty) {
+            SearchSituation situation;
+            situation.board = Bitboard::fromBoard(board);
+            situation.current = currentTetrimino;
+            situation.stored = storedTetrimino.type;
+            situation.canHold = !hasSwapped;
+            situation.preview = {{static_cast<int8_t>(nextTetrimino.type), static_cast<int8_t>(nextTetrimino1.type),
+                                  static_cast<int8_t>(nextTetrimino2.type)}};
+            situation.nextPieces = pieceRng.possibleNext();
+            if (searchWorker.submit(situation, SEARCH_BUDGET, placementSearch)) {
+                searchedSituation = situation;
+                searchDirty = false;
+            }
+        }
+
+        SearchMove move;
+        if (searchWorker.poll(move) && move.found) {
+            tetrisElement->perfectClearAvailable = move.perfectClear;
+            searchResult = move;
+            searchReady = true;
+
+            Tetrimino hint(move.type);
+            hint.x = move.placement.x;
+            hint.y = move.placement.y;
+            hint.rotation = move.placement.rotation;
+            tetrisElement->hintTetrimino = hint;
+        }
+    }
+
+    // Quantize the frame clock to whole milliseconds so that recorded deltas
+    // reproduce the exact timestamps the live game saw
+    void advanceFrameClock() {
+        auto previousFrameTime = frameTime;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - clockOrigin);
+        frameTime = clockOrigin + elapsed;
+        frameDeltaMs = static_cast<uint32_t>(std::max<int64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(frameTime - previousFrameTime).count(), 0));
+    }
+
+    // FNV-1a over the observable game state, used to verify bit-exact playback
+    uint32_t computeStateHash() {
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                hash = (hash ^ static_cast<uint8_t>(value >> (8 * i))) * 16777619u;
+            }
+        };
+        for (const auto& row : board) {
+            for (int cell : row) mix(cell);
+        }
+        for (const Tetrimino* tet : {&currentTetrimino, &nextTetrimino, &nextTetrimino1, &nextTetrimino2, &storedTetrimino}) {
+            mix(tet->type);
+            mix(tet->x);
+            mix(tet->y);
+            mix(tet->rotation);
+        }
+        mix(tetrisElement->getScore());
+        mix(tetrisElement->getLinesCleared());
+        mix(tetrisElement->getLevel());
+        return hash;
+    }
+
+    // Write out the running recording (if any) as the last replay
+    void finishRecording() {
+        if (!replayRecorder.isRecording()) return;
+        replayRecorder.stop();
+
+        // Keep the previous replay if nothing happened in this one
+        if (piecesSpawned == recordingStartPiece) return;
+
+        // Hand the recording over to the I/O worker without copying the stream
+        auto recording = std::make_shared<ReplayRecorder>(std::move(replayRecorder));
+        replayRecorder = ReplayRecorder();
+        uint32_t stateHash = computeStateHash();
+        ioWorker.submit(REPLAY_DIRECTORY + "last.rpl", [recording, stateHash]() {
+            createDirectory(REPLAY_DIRECTORY);
+            return recording->serialize(stateHash);
+        }, true);
+
+        // Per-piece finesse report next to the replay it belongs to; the reports may give way
+        // to saves and replays when the writer falls behind
+        auto records = std::make_shared<std::vector<FinesseRecord>>(finesseRecords);
+        ioWorker.submit(REPLAY_DIRECTORY + "last_finesse.csv", [records]() {
+            createDirectory(REPLAY_DIRECTORY);
+            return encodeFinesseReport(*records);
+        }, true, std::chrono::milliseconds(0), true);
+
+        // Input latency of the game, then a fresh histogram for the next one
+        auto latency = std::make_shared<LatencyHistogram>(inputLatency.results());
+        ioWorker.submit(REPLAY_DIRECTORY + "last_latency.csv", [latency]() {
+            createDirectory(REPLAY_DIRECTORY);
+            return encodeLatencyReport(*latency);
+        }, true, std::chrono::milliseconds(0), true);
+        inputLatency.reset();
+    }
+
+    void startPlayback() {
+        // Make the current game watchable too, then park it in the save file
+        finishRecording();
+        if (!replayReader.loadFromFile(REPLAY_DIRECTORY + "last.rpl")) return;
+        parkedGame = encodeSaveState(captureSnapshot(), TetrisElement::maxHighScore);
+
+        replayPlaying = true;
+        seekPlayback(0);
+    }
+
+    // Restore the nearest keyframe at or before targetMs and simulate forward to it
+    void seekPlayback(int64_t targetMs) {
+        targetMs = std::max<int64_t>(targetMs, 0);
+
+        const ReplayKeyframe* keyframe = replayReader.findKeyframe(targetMs);
+        if (keyframe && restoreSaveRecord(keyframe->state)) {
+            replayReader.seekTo(*keyframe);
+        } else {
+            // Replays without a keyframe 0 were recorded before handling profiles existed
+            replayReader.rewind();
+            handling = CLASSIC_HANDLING;
+            newGame(replayReader.getSeed());
+        }
+
+        // Effects of the skipped frames are not meant to be seen
+        ReplayFrame frame;
+        publishEvents = false;
+        while (!replayReader.atEnd() && static_cast<int64_t>(replayReader.getClockMs()) < targetMs && replayReader.next(frame)) {
+            frameTime += std::chrono::milliseconds(frame.deltaMs);
+            stepFrame(fromReplayMask(frame.down), fromReplayMask(frame.held));
+        }
+        publishEvents = true;
+        tetrisElement->clearEffects();
+
+        playbackStartTime = std::chrono::steady_clock::now() - std::chrono::milliseconds(replayReader.getClockMs());
+        TetrisElement::replayLabel = "Replay";
+    }
+
+    bool handlePlaybackInput(u64 keysDown) {
+        // Any press of B leaves playback; all other live input is ignored
+        if (keysDown & KEY_B) {
+            stopPlayback();
+            return true;
+        }
+
+        // Seek 10 seconds backwards or forwards
+        if (keysDown & (KEY_LEFT | KEY_RIGHT)) {
+            int64_t offsetMs = (keysDown & KEY_LEFT) ? -10000 : 10000;
+            seekPlayback(static_cast<int64_t>(replayReader.getClockMs()) + offsetMs);
+            return true;
+        }
+
+        // Feed recorded frames until the replay clock catches up with real time
+        uint64_t realElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - playbackStartTime).count();
+        ReplayFrame frame;
+        int frameBudget = 600; // Bound the catch-up work done in a single frame
+        while (replayPlaying && !replayReader.atEnd() && replayReader.getClockMs() <= realElapsedMs && frameBudget-- > 0) {
+            if (!replayReader.next(frame)) break;
+            frameTime += std::chrono::milliseconds(frame.deltaMs);
+            stepFrame(fromReplayMask(frame.down), fromReplayMask(frame.held));
+        }
+        if (replayPlaying && replayReader.atEnd()) {
+            finishPlayback();
+        }
+        return true;
+    }
+
+    // Hold the final position on screen and report whether it matches the recording
+    void finishPlayback() {
+        if (TetrisElement::replayLabel != "Replay") return;
+        TetrisElement::replayLabel = (computeStateHash() == replayReader.getStateHash()) ? "Replay End" : "Desync";
+    }
+
+    void stopPlayback() {
+        replayPlaying = false;
+        TetrisElement::replayLabel.clear();
+
+        // Return to the live game and resync the frame clock with real time
+        advanceFrameClock();
+        restoreSaveRecord(parkedGame);
+        parkedGame.clear();
+        timeSinceLastFrame = frameTime;
+        lastRotationOrMoveTime = frameTime;
+        TetrisElement::paused = true;
+        startRecordingFromCurrentState();
+    }
     
     
 
@@ -1651,13 +2483,54 @@ private:
     Tetrimino nextTetrimino;
     Tetrimino nextTetrimino1;
     Tetrimino nextTetrimino2;
-    TetrisElement* tetrisElement;
+    TetrisElement* tetrisElement = nullptr;
     u16 _w;
     u16 _h;
     std::chrono::time_point<std::chrono::steady_clock> timeSinceLastFrame;
 
+    // Frame clock; in playback it is advanced by the recorded deltas instead
+    std::chrono::time_point<std::chrono::steady_clock> clockOrigin;
+    std::chrono::time_point<std::chrono::steady_clock> frameTime;
+    uint32_t frameDeltaMs;
+
+    // Piece generation and replay state
+    PieceRandomizer pieceRng;
+    uint64_t gameSeed = 0;
+    ReplayRecorder replayRecorder;
+    ReplayReader replayReader;
+    bool replayPlaying = false;
+    std::chrono::time_point<std::chrono::steady_clock> playbackStartTime;
+    uint32_t piecesSpawned = 0;
+    uint32_t recordingStartPiece = 0;
+    uint32_t nextKeyframePiece = 0;
+    std::vector<uint8_t> parkedGame; // Live game set aside while a replay plays
+
+    // Background saves and replay writes; the destructor flushes with a bounded wait
+    IoWorker ioWorker{4, IO_SHUTDOWN_TIMEOUT};
+    uint32_t lastAutosavePiece = 0;
+    bool lastAutosavePaused = false;
+
+    // Placement search for hints and autoplay runs on its own thread; searchDirty
+    // means the situation changed since the last submit
+    SearchWorker searchWorker;
+    bool searchDirty = true;
+    SearchSituation searchedSituation;
+    SearchMove searchResult;
+    bool searchReady = false;
+
+    // Finesse of the pieces locked since the game started or was restored
+    FinesseTracker finesse;
+    std::vector<FinesseRecord> finesseRecords;
+
+    // Autoplay bot (autoplaySetting indexes AUTOPLAY_SPEEDS, -1 when off)
+    int autoplaySetting = -1;
+    std::vector<AutoplayFrame> autoplayPlan;
+    size_t autoplayIndex = 0;
+    std::chrono::time_point<std::chrono::steady_clock> autoplayPieceStart, autoplayNextPiece;
+    std::chrono::time_point<std::chrono::steady_clock> autoplayGameOverTime;
+    bool autoplaySawGameOver = false;
+
     // Lock delay variables
-    std::chrono::milliseconds lockDelayTime;
     std::chrono::milliseconds lockDelayCounter;
 
     // Fall speed variables
@@ -1667,14 +2540,22 @@ private:
     int totalSoftDropDistance = 0;  // Tracks the number of rows dropped for soft drops
     int hardDropDistance = 0;       // Tracks the number of rows dropped for hard drops
 
-    int maxLockDelayMoves = 15;  // Maximum number of times the player can move left/right before the piece locks
     int lockDelayMoves = 0;  // Number of times the player has moved left/right since the piece hit the ground
 
     // Add a member variable to track if a wall kick was applied
     bool lastWallKickApplied = false;
-    bool previousClearWasTetris = false; // Track if the previous clear was a Tetris
-    bool previousClearWasTSpin = false;  // Track if the previous clear was a T-Spin
-    int backToBackCount = 1;
+    ScoringState scoring;  // Back-to-back and combo chain between locks
+    GamePhase phase = PHASE_FALLING;  // Falling, Locking, LineClear or Entry; see currentPhase()
+    std::chrono::time_point<std::chrono::steady_clock> phaseDeadline; // End of the line-clear or entry delay
+    uint8_t entryInput = 0;  // EntryInput presses kept for the next piece
+    bool publishEvents = true; // Off while a replay seek simulates frames nobody sees
+    uint32_t stateVersion = 0;
+    std::array<int64_t, 8> lastStateSignature{};
+
+    // Between a finished game and the next one while the board explodes
+    static constexpr auto RESET_ANIMATION_TIME = std::chrono::milliseconds(300);
+    bool resetPending = false;
+    std::chrono::time_point<std::chrono::steady_clock> resetDeadline;
 
     bool pieceWasKickedUp = false;
 
@@ -1772,6 +2653,7 @@ private:
             currentTetrimino.y -= dy;
         } else {
             success = true;
+            lastMoveWasRotation = false;
     
             // If the piece moved down
             if (dy > 0) {
@@ -1787,14 +2669,14 @@ private:
             // Horizontal movement logic remains the same
             else if (dx != 0) {
                 if (isOnFloor()) {
-                    if (lockDelayMoves < maxLockDelayMoves) {
+                    if (lockDelayMoves < handling.moveResetLimit) {
                         lockDelayCounter = std::chrono::milliseconds(0);
-                        lastRotationOrMoveTime = std::chrono::steady_clock::now();
+                        lastRotationOrMoveTime = frameTime;
                         lockDelayMoves++;
                     }
                 } else {
                     lockDelayCounter = std::chrono::milliseconds(0);
-                    lastRotationOrMoveTime = std::chrono::steady_clock::now();
+                    lastRotationOrMoveTime = frameTime;
                 }
             }
         }
@@ -1811,7 +2693,9 @@ private:
         rotatePiece(1); // Counterclockwise rotation
     }
 
-    bool tSpinOccurred = false; // Add this member to TetrisGui class
+    bool lastMoveWasRotation = false; // The current piece's last successful action was a rotation
+    bool lastKickWasFar = false;      // That rotation needed a standard kick of two rows
+    TSpinType lockedSpin = TSPIN_NONE; // Spin of the piece that locked last; scored by clearLines
     
     void rotatePiece(int direction) {
         std::lock_guard<std::mutex> lock(boardMutex);  // Lock the board for safe rotation
@@ -1827,6 +2711,7 @@ private:
         
         lastWallKickApplied = false;  // Reset the wall kick flag
         bool rotationSuccessful = false;
+        bool farKick = false;
         
         // First, check if the piece can fit without any kick
         if (isPositionValid(currentTetrimino, board)) {
@@ -1845,6 +2730,7 @@ private:
                 if (isPositionValid(currentTetrimino, board)) {
                     rotationSuccessful = true;
                     lastWallKickApplied = (kick.first != 0 || kick.second != 0);
+                    farKick = (kick.second == 2 || kick.second == -2);
                     
                     // Check if the piece was kicked upwards
                     pieceWasKickedUp = (kick.second < 0);
@@ -1854,7 +2740,6 @@ private:
     
             // If standard kicks fail, try extra kicks in tight spaces
             if (!rotationSuccessful) {
-                const std::array<std::pair<int, int>, 7> extraKicks = {{ {0, 1}, {0, -1}, {1, 0}, {-1, 0}, {0, 2}, {2, 0}, {-2, 0} }};
                 for (const auto& kick : extraKicks) {
                     currentTetrimino.x = previousX + kick.first;
                     currentTetrimino.y = previousY + kick.second;
@@ -1877,19 +2762,22 @@ private:
             currentTetrimino.x = previousX;
             currentTetrimino.y = previousY;
             pieceWasKickedUp = false;
+        } else {
+            lastMoveWasRotation = true;
+            lastKickWasFar = farKick;
         }
     
         // Reset lock delay only if the rotation was successful and state changed
         if ((rotationSuccessful && currentTetrimino.rotation != previousRotation) || currentTetrimino.type == 3) {
             if (isOnFloor()) {
-                if (lockDelayMoves < maxLockDelayMoves) {
+                if (lockDelayMoves < handling.moveResetLimit) {
                     lockDelayCounter = std::chrono::milliseconds(0);
-                    lastRotationOrMoveTime = std::chrono::steady_clock::now();
+                    lastRotationOrMoveTime = frameTime;
                     lockDelayMoves++;
                 }
             } else {
                 lockDelayCounter = std::chrono::milliseconds(0);
-                lastRotationOrMoveTime = std::chrono::steady_clock::now();
+                lastRotationOrMoveTime = frameTime;
             }
         }
     }
@@ -1899,38 +2787,40 @@ private:
         return lastWallKickApplied;  // Simply return whether the last rotation involved a wall kick
     }
 
-    bool isMiniTSpin() {
-        if (currentTetrimino.type != 5) return false; // Only T piece can T-Spin
-    
-        // Mini T-Spins often occur when a rotation involves a wall kick but isn't surrounded as a full T-spin.
-        return !isTSpin() && lastWallKickApplied;
-    }
-    
-    bool isTSpin() {
-        if (currentTetrimino.type != 5) return false; // Only T piece can T-Spin
-    
-        // Check corners around the T piece center
-        int centerX = currentTetrimino.x + 1;
-        int centerY = currentTetrimino.y + 1;
-        int blockedCorners = 0;
-    
-        // Check four corners
-        if (!isWithinBounds(centerX - 1, centerY - 1) || board[centerY - 1][centerX - 1] != 0) blockedCorners++;
-        if (!isWithinBounds(centerX + 1, centerY - 1) || board[centerY - 1][centerX + 1] != 0) blockedCorners++;
-        if (!isWithinBounds(centerX - 1, centerY + 1) || board[centerY + 1][centerX - 1] != 0) blockedCorners++;
-        if (!isWithinBounds(centerX + 1, centerY + 1) || board[centerY + 1][centerX + 1] != 0) blockedCorners++;
-    
-        // A T-Spin occurs if 3 or more corners are blocked
-        return blockedCorners >= 3 && lastWallKickApplied;
-    }
-    
     bool isWithinBounds(int x, int y) {
         return x >= 0 && x < BOARD_WIDTH && y >= 0 && y < BOARD_HEIGHT;
     }
     
 
 
+    // Decide once, on the board the piece locks into, whether it was a T-spin
+    void classifyLockedSpin() {
+        uint8_t corners = tSpinCorners(currentTetrimino.x, currentTetrimino.y, [this](int x, int y) {
+            return !isWithinBounds(x, y) || board[y][x] != 0;
+        });
+        lockedSpin = classifyTSpin(currentTetrimino.type, currentTetrimino.rotation, corners,
+                                   lastMoveWasRotation, lastKickWasFar);
+    }
+
+    // Compare the presses that brought the current piece to rest with the fewest that could have
+    void judgeFinesse() {
+        if (autoplaySetting >= 0) return; // The bot taps out DAS moves, so its pieces say nothing about the player
+        finesseRecords.push_back(finesse.lockPiece(Bitboard::fromBoard(board), currentTetrimino,
+                                                   lastMoveWasRotation, piecesSpawned));
+        tetrisElement->finesseFaults = finesse.faults;
+    }
+
+    void resetFinesse() {
+        finesse.reset();
+        finesse.startPiece(currentTetrimino);
+        finesseRecords.clear();
+        tetrisElement->finesseFaults = 0;
+    }
+
     void placeTetrimino() {
+        classifyLockedSpin();
+        judgeFinesse();
+
         std::lock_guard<std::mutex> lock(boardMutex); // Lock the mutex for board access
         bool pieceAboveTop = false;  // Track if any part of the piece is above the top of the board
 
@@ -1960,9 +2850,11 @@ private:
         }
         pieceWasKickedUp = false;
 
+        publish(pieceEvent(EVENT_PIECE_LOCKED));
+
         // If any part of the piece was above the top of the board, trigger game over
         if (pieceAboveTop) {
-            tetrisElement->gameOver = true;
+            topOut();
             return;  // Early return to prevent further processing
         }
     
@@ -1982,50 +2874,34 @@ private:
         
     }
 
-    // Create line clear particles outside the main line-clear loop to reduce mutex locking time
-    void createLineClearParticles(int row) {
-        for (int x = 0; x < BOARD_WIDTH; ++x) {
-            for (int p = 0; p < 10; ++p) {
-                particles.push_back(Particle{
-                    static_cast<float>(x * _w + _w / 2),
-                    static_cast<float>(row * _h + _h / 2),
-                    (rand() % 100 / 50.0f - 1.0f) * 8,
-                    (rand() % 100 / 50.0f - 1.0f) * 8,
-                    0.5f,
-                    1.0f
-                });
-            }
-        }
+    
+    // Hand an event to the presentation; dropped while replay frames are skipped
+    void publish(const GameEvent& event) {
+        if (publishEvents) gameEvents.push(event);
     }
 
-    void createCenterExplosionParticles() {
-        // Calculate the center row of the board
-        //int centerRow = BOARD_HEIGHT / 2;
-        for (int y = 0; y < BOARD_HEIGHT; ++y) {
-            // Generate particles at the center row
-            for (int x = 0; x < BOARD_WIDTH; ++x) {
-                for (int p = 0; p < 10; ++p) {
-                    particles.push_back(Particle{
-                        static_cast<float>(x * _w + _w / 2),  // X position in the center row
-                        static_cast<float>(y * _h + _h / 2),  // Y position in the center row
-                        (rand() % 100 / 50.0f - 1.0f) * 8,  // Random velocity in X direction
-                        (rand() % 100 / 50.0f - 1.0f) * 8,  // Random velocity in Y direction
-                        0.5f,  // Lifespan
-                        1.0f   // Initial alpha (fully visible)
-                    });
-                }
-            }
-        }
+    // Event about the current piece where it is now
+    GameEvent pieceEvent(GameEventType type) const {
+        GameEvent event;
+        event.type = type;
+        event.piece = static_cast<int8_t>(currentTetrimino.type);
+        event.x = static_cast<int8_t>(currentTetrimino.x);
+        event.y = static_cast<int8_t>(currentTetrimino.y);
+        event.rotation = static_cast<uint8_t>(currentTetrimino.rotation);
+        return event;
     }
 
-    
-    // Modify the clearLines function to handle scoring and leveling up
-    void clearLines() {
-        std::lock_guard<std::mutex> particleLock(particleMutex);  // Lock the particle system to avoid concurrent access
+    void topOut() {
+        if (!tetrisElement->gameOver) publish(GameEvent{EVENT_TOP_OUT});
+        tetrisElement->gameOver = true;
+    }
+
+    // Clear full rows, score the lock and level up; returns the number of rows cleared
+    int clearLines() {
         std::lock_guard<std::mutex> lock(boardMutex);  // Lock during line clearing
         
         int linesClearedInThisTurn = 0;
-        int totalYPosition = 0;
+        uint32_t clearedRows = 0;
         
         bool fullLine;
         for (int i = 0; i < BOARD_HEIGHT; ++i) {
@@ -2040,10 +2916,7 @@ private:
     
             if (fullLine) {
                 linesClearedInThisTurn++;
-                totalYPosition += i * _h;
-    
-                // Particle creation moved to another method to reduce mutex lock time
-                createLineClearParticles(i);
+                clearedRows |= 1u << i;
     
                 // Shift rows down after clearing the full line
                 for (int y = i; y > 0; --y) {
@@ -2061,131 +2934,71 @@ private:
             }
         }
     
-        // If lines were cleared, update the score and level, and show feedback text
+        bool perfectClear = false;
         if (linesClearedInThisTurn > 0) {
-            // Update the total lines cleared
-            tetrisElement->setLinesCleared(tetrisElement->getLinesCleared() + linesClearedInThisTurn);
-            
-            int baseScore = 0;
-            float backToBackBonus = 1.0f;
-        
-            // Handle back-to-back bonus
-            bool isBackToBack = (previousClearWasTetris || previousClearWasTSpin) &&
-                                (linesClearedInThisTurn == 4 || isTSpin());
-        
-
-            // Track the back-to-back chain count
-            //static int backToBackCount = 1;
-            if (isBackToBack) {
-                backToBackBonus = 1.5f;  // 50% bonus for back-to-back Tetrises or T-Spins
-                backToBackCount++;  // Increment back-to-back count
-            } else {
-                backToBackCount = 1;  // Reset back-to-back count
-            }
-        
-            // Update score based on how many lines were cleared
-            switch (linesClearedInThisTurn) {
-                case 1:
-                    if (isTSpin()) {
-                        baseScore = isMiniTSpin() ? 100 : 400;  // Mini T-Spin or T-Spin Single
-                    } else {
-                        baseScore = 100;  // Single line clear
-                    }
-                    break;
-                case 2:
-                    if (isTSpin()) {
-                        baseScore = 700;  // T-Spin Double
-                    } else {
-                        baseScore = 300;  // Double line clear
-                    }
-                    break;
-                case 3:
-                    baseScore = 500;  // Triple line clear
-                    break;
-                case 4:
-                    baseScore = 800;  // Base Tetris
-                    break;
-            }
-        
-            // Apply back-to-back bonus for Tetrises and T-Spins
-            if ((linesClearedInThisTurn == 4 || isTSpin()) && isBackToBack) {
-                baseScore = static_cast<int>(baseScore * backToBackBonus);  // Apply bonus
+            perfectClear = true;
+            for (int y = 0; y < BOARD_HEIGHT && perfectClear; ++y) {
+                for (int x = 0; x < BOARD_WIDTH; ++x) {
+                    if (board[y][x] != 0) perfectClear = false;
+                }
             }
-        
-            // Multiply base score by the current level
-            int newScore = baseScore * tetrisElement->getLevel();
-            tetrisElement->setScore(tetrisElement->getScore() + newScore);
-        
-            // Store the score for the current lines-cleared move in linesClearedScore
-            tetrisElement->linesClearedScore = newScore;
-        
-            // Handle back-to-back state
-            if (linesClearedInThisTurn == 4) {
-                previousClearWasTetris = true;
-                previousClearWasTSpin = false;
-            } else if (isTSpin()) {
-                previousClearWasTSpin = true;
-                previousClearWasTetris = false;
-            } else {
-                previousClearWasTetris = false;
-                previousClearWasTSpin = false;
+        }
+
+        LockScore lockScore = scoreLock(scoring, linesClearedInThisTurn, lockedSpin, perfectClear, tetrisElement->getLevel());
+        tetrisElement->setScore(tetrisElement->getScore() + lockScore.points);
+
+        if (lockedSpin != TSPIN_NONE) {
+            GameEvent spin = pieceEvent(EVENT_SPIN_DETECTED);
+            spin.spin = lockedSpin;
+            spin.lines = static_cast<uint8_t>(linesClearedInThisTurn);
+            if (linesClearedInThisTurn == 0) {
+                spin.points = lockScore.points;
+                spin.banner = lockScore.banner;
             }
-        
-            // Level up after clearing a certain number of lines
+            publish(spin);
+        }
+
+        // Update the total lines cleared, and level up after clearing a certain number of lines
+        if (linesClearedInThisTurn > 0) {
+            GameEvent cleared;
+            cleared.type = EVENT_LINES_CLEARED;
+            cleared.lines = static_cast<uint8_t>(linesClearedInThisTurn);
+            cleared.rows = clearedRows;
+            cleared.points = lockScore.points;
+            cleared.banner = lockScore.banner;
+            cleared.backToBack = lockScore.backToBack;
+            cleared.value = scoring.backToBackCount;
+            cleared.perfectClear = lockScore.perfectClear;
+            publish(cleared);
+
+            tetrisElement->setLinesCleared(tetrisElement->getLinesCleared() + linesClearedInThisTurn);
+            
             linesClearedForLevelUp += linesClearedInThisTurn;
             if (linesClearedForLevelUp >= LINES_PER_LEVEL) {
                 linesClearedForLevelUp -= LINES_PER_LEVEL;  // Reset the count for the next level
                 tetrisElement->setLevel(tetrisElement->getLevel() + 1);  // Increase the level
+
+                GameEvent levelUp;
+                levelUp.type = EVENT_LEVEL_UP;
+                levelUp.value = tetrisElement->getLevel();
+                publish(levelUp);
             }
-        
-            // Show feedback text based on the number of lines cleared
-            switch (linesClearedInThisTurn) {
-                case 1:
-                    tetrisElement->linesClearedText = isTSpin() ? "T-Spin\nSingle" : "Single";
-                    break;
-                case 2:
-                    tetrisElement->linesClearedText = isTSpin() ? "T-Spin\nDouble" : "Double";
-                    break;
-                case 3:
-                    tetrisElement->linesClearedText = "Triple";
-                    break;
-                case 4:
-                    tetrisElement->linesClearedText = isBackToBack ? std::to_string(backToBackCount) + "x Tetris" : "Tetris";
-                    break;
-            }
-        
-            tetrisElement->showText = true;
-            tetrisElement->fadeAlpha = 0.0f;  // Start fade animation
-            tetrisElement->textStartTime = std::chrono::steady_clock::now();  // Track animation start time
         }
-        
-
+        return linesClearedInThisTurn;
     }
     
 
     void spawnNewTetrimino() {
         // Move nextTetrimino to currentTetrimino
         currentTetrimino = nextTetrimino;
-        
-        int rotatedIndex;
+        piecesSpawned++;
 
-        // Calculate the width of the current Tetrimino
-        int minX = 4, maxX = -1;  // Initialize with the opposite extremes
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                rotatedIndex = getRotatedIndex(currentTetrimino.type, i, j, currentTetrimino.rotation);
-                if (tetriminoShapes[currentTetrimino.type][rotatedIndex] != 0) {
-                    if (j < minX) minX = j;
-                    if (j > maxX) maxX = j;
-                }
-            }
-        }
-    
-        // Calculate the actual width of the Tetrimino
-        int pieceWidth = maxX - minX + 1;
-    
-        // Set the X position to center the Tetrimino on the board
-        currentTetrimino.x = (BOARD_WIDTH - pieceWidth) / 2 - minX;
+        // Center the piece horizontally with its topmost block on the top edge
+        placeAtSpawn(currentTetrimino);
+        phase = PHASE_FALLING;
+        lastMoveWasRotation = false;
+        finesse.startPiece(currentTetrimino);
+        invalidateSearch();
     
         // Move nextTetrimino1 to nextTetrimino
         nextTetrimino = nextTetrimino1;
@@ -2194,27 +3007,12 @@ private:
         nextTetrimino1 = nextTetrimino2;
     
         // Generate a new random piece for nextTetrimino2
-        nextTetrimino2 = Tetrimino(rand() % 7);
-    
-        // Calculate the topmost row with a block to adjust the starting Y position
-        int topmostRow = 4;  // Start with the assumption that the piece may be 4 rows high
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                rotatedIndex = getRotatedIndex(currentTetrimino.type, i, j, currentTetrimino.rotation);
-                if (tetriminoShapes[currentTetrimino.type][rotatedIndex] != 0) {
-                    topmostRow = std::min(topmostRow, i);  // Find the topmost row with a block
-                    break;  // No need to continue checking this row
-                }
-            }
-        }
-    
-        // Set the initial Y position, adjusted for the topmost block
-        currentTetrimino.y = -topmostRow;  // Allow the piece to start partially off-screen if necessary
+        nextTetrimino2 = Tetrimino(pieceRng.next());
     
         // Check if the new Tetrimino is in a valid position
         if (!isPositionValid(currentTetrimino, board)) {
             // Game over: the new Tetrimino can't be placed
-            tetrisElement->gameOver = true;
+            topOut();
         }
     }
 
@@ -2231,7 +3029,11 @@ public:
     virtual void exitServices() override {}
 
     virtual void onShow() override {}
-    virtual void onHide() override { TetrisElement::paused = true; }
+    virtual void onHide() override {
+        if (!gameGui) return;
+        gameGui->pauseForHide();
+        gameGui->saveGameState(); // Persist right away in case the overlay never comes back
+    }
 
     virtual std::unique_ptr<tsl::Gui> loadInitialGui() override {
         firstLoad = true;
@@ -2242,7 +3044,7 @@ public:
 
 private:
     std::string savedGameData;
-    TetrisGui* gameGui;
+    TetrisGui* gameGui = nullptr;
 };
 
 /**
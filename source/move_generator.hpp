@@ -0,0 +1,301 @@
+/********************************************************************************
+ * File: move_generator.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Reachable-placement search for the Tetris Overlay. Starting from the
+ *   active piece, a breadth-first search over (x, y, rotation) states walks
+ *   every input the player has (shifts, DAS shifts, soft and sonic drops and
+ *   both rotations with the full SRS and extraKicks fallback of rotatePiece)
+ *   and reports each distinct resting placement together with the shortest
+ *   input path that reaches it.
+ *
+ *   Lock delay limits are not modelled: a placement counts as reachable if
+ *   some input sequence gets there, however long the piece spends on the
+ *   floor.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "bitboard.hpp"
+#include "tspin.hpp"
+
+// Player inputs the search expands; DAS and sonic moves are single macro steps
+enum MoveInput : uint8_t {
+    MOVE_LEFT,
+    MOVE_RIGHT,
+    MOVE_SOFT_DROP,   // One row down
+    MOVE_ROTATE_CW,   // rotate(), the A button
+    MOVE_ROTATE_CCW,  // rotateCounterclockwise(), the B button
+    MOVE_DAS_LEFT,    // Shift left until blocked
+    MOVE_DAS_RIGHT,   // Shift right until blocked
+    MOVE_SONIC_DROP,  // Soft drop until landed
+    MOVE_INPUT_COUNT
+};
+
+constexpr size_t MOVE_MAX_PATH = 32;
+constexpr size_t MOVE_MAX_PLACEMENTS = 256;
+
+// Rotation outcome flags carried by a search state and its placement
+enum PlacementFlag : uint8_t {
+    PLACEMENT_ROTATED   = 1 << 0, // Last successful input was a rotation
+    PLACEMENT_WALL_KICK = 1 << 1, // That rotation needed a kick offset
+    PLACEMENT_TSPIN     = 1 << 2  // T piece rotated in with three or more corners blocked
+};
+
+// Where a piece comes to rest and how to get it there (a hard drop follows the path)
+struct Placement {
+    int8_t x = 0, y = 0;
+    uint8_t rotation = 0;
+    uint8_t flags = 0;
+    uint8_t pathLength = 0;
+    std::array<MoveInput, MOVE_MAX_PATH> path{};
+};
+
+// Result of one rotation attempt, mirroring TetrisGui::rotatePiece
+struct RotationResult {
+    bool success = false;
+    bool wallKick = false;
+    bool farKick = false;  // A standard kick that moved the piece two rows
+    int x = 0, y = 0, rotation = 0;
+};
+
+inline RotationResult tryRotate(const Bitboard& board, int type, int x, int y, int rotation, int direction) {
+    RotationResult result;
+    result.rotation = (rotation + direction + 4) % 4;
+    const PieceMask& mask = pieceMask(type, result.rotation);
+
+    if (board.fits(mask, x, y)) {
+        result.success = true;
+        result.x = x;
+        result.y = y;
+        return result;
+    }
+
+    const auto& kicks = (type == 0) ? wallKicksI : wallKicksJLSTZ;
+    int kickIndex = (direction > 0) ? rotation : result.rotation;
+    for (const auto& kick : kicks[kickIndex]) {
+        if (board.fits(mask, x + kick.first, y + kick.second)) {
+            result.success = true;
+            result.wallKick = (kick.first != 0 || kick.second != 0);
+            result.farKick = (kick.second == 2 || kick.second == -2);
+            result.x = x + kick.first;
+            result.y = y + kick.second;
+            return result;
+        }
+    }
+
+    for (const auto& kick : extraKicks) {
+        if (board.fits(mask, x + kick.first, y + kick.second)) {
+            result.success = true;
+            result.wallKick = true;
+            result.x = x + kick.first;
+            result.y = y + kick.second;
+            return result;
+        }
+    }
+
+    return result;
+}
+
+// Corners around the T center that are filled or off the board, as counted by the three-corner rule
+inline int countTSpinCorners(const Bitboard& board, int x, int y) {
+    return std::popcount(tSpinCorners(board, x, y));
+}
+
+class MoveGenerator {
+public:
+    // Enumerate every distinct resting placement of the piece starting at (x, y, rotation)
+    size_t generate(const Bitboard& board, int type, int x, int y, int rotation, bool recordPaths = true) {
+        placementCount = 0;
+        queueSize = 0;
+        std::memset(visited, 0, sizeof(visited));
+        std::memset(placementKeys, 0, sizeof(placementKeys));
+        std::memset(slideMemo, 0, sizeof(slideMemo));
+
+        if (!board.fits(type, rotation, x, y)) return 0;
+        enqueue(x, y, rotation, 0, NO_PARENT, MOVE_INPUT_COUNT);
+
+        for (size_t head = 0; head < queueSize; ++head) {
+            const Node node = queue[head];
+
+            if (!board.fits(type, node.rotation, node.x, node.y + 1)) {
+                addPlacement(board, type, head, recordPaths);
+            }
+
+            expand(board, type, head, node);
+        }
+        return placementCount;
+    }
+
+    size_t generate(const Bitboard& board, const Tetrimino& tet, bool recordPaths = true) {
+        return generate(board, tet.type, tet.x, tet.y, tet.rotation, recordPaths);
+    }
+
+    size_t size() const { return placementCount; }
+    const Placement& operator[](size_t index) const { return placements[index]; }
+    const Placement* begin() const { return placements; }
+    const Placement* end() const { return placements + placementCount; }
+
+    // Occupied cells of a resting piece: one row index plus four shifted row masks.
+    // Equal keys mean the same cells, whatever rotation and position produced them.
+    static uint64_t cellKey(int type, int rotation, int x, int y) {
+        const PieceMask& mask = pieceMask(type, rotation);
+        uint64_t key = uint64_t(y + mask.top + Y_OFFSET);
+        for (int i = mask.top; i < mask.top + 4; ++i) {
+            uint16_t row = (i <= mask.bottom) ? uint16_t(mask.rows[i] << (x + mask.minCol)) : 0;
+            key = (key << 10) | row;
+        }
+        return key;
+    }
+
+private:
+    // Search bounds; anything outside cannot hold a valid piece (or is too high to matter)
+    static constexpr int X_OFFSET = 3, X_RANGE = 16;
+    static constexpr int Y_OFFSET = 6, Y_RANGE = BOARD_HEIGHT + Y_OFFSET;
+    static constexpr int FLAG_STATES = 4;
+    static constexpr size_t STATE_COUNT = size_t(X_RANGE) * Y_RANGE * 4 * FLAG_STATES;
+    static constexpr uint16_t NO_PARENT = 0xFFFF;
+    static constexpr size_t KEY_SLOTS = MOVE_MAX_PLACEMENTS * 2;
+
+    struct Node {
+        int8_t x, y;
+        uint8_t rotation;
+        uint8_t flags;
+        uint16_t parent;
+        MoveInput input;
+    };
+
+    Node queue[STATE_COUNT];
+    size_t queueSize = 0;
+    uint64_t visited[(STATE_COUNT + 63) / 64];
+
+    Placement placements[MOVE_MAX_PLACEMENTS];
+    size_t placementCount = 0;
+    uint64_t placementKeys[KEY_SLOTS]; // Open-addressed set of occupied-cell keys, 0 when empty
+
+    enum SlideDirection { SLIDE_LEFT, SLIDE_RIGHT, SLIDE_DOWN, SLIDE_DIRECTIONS };
+    static constexpr int SLIDE_BIAS = 64; // Stored coordinates are biased so 0 means unknown
+    uint8_t slideMemo[SLIDE_DIRECTIONS][4][Y_RANGE][X_RANGE];
+
+    void enqueue(int x, int y, int rotation, uint8_t flags, uint16_t parent, MoveInput input) {
+        if (x + X_OFFSET < 0 || x + X_OFFSET >= X_RANGE || y + Y_OFFSET < 0 || y + Y_OFFSET >= Y_RANGE) return;
+
+        size_t state = ((size_t(y + Y_OFFSET) * X_RANGE + (x + X_OFFSET)) * 4 + rotation) * FLAG_STATES + flags;
+        uint64_t bit = uint64_t(1) << (state & 63);
+        if (visited[state >> 6] & bit) return;
+        visited[state >> 6] |= bit;
+
+        queue[queueSize++] = {int8_t(x), int8_t(y), uint8_t(rotation), flags, parent, input};
+    }
+
+    // Where a repeated shift from a valid position stops (the x or y coordinate along the
+    // slide). Every position on the way shares the answer, so the whole run is memoized.
+    int slide(const Bitboard& board, const PieceMask& mask, int rotation, int x, int y, int direction) {
+        uint8_t& cached = slideMemo[direction][rotation][y + Y_OFFSET][x + X_OFFSET];
+        if (cached) return cached - SLIDE_BIAS;
+
+        int dx = (direction == SLIDE_LEFT) ? -1 : (direction == SLIDE_RIGHT) ? 1 : 0;
+        int dy = (direction == SLIDE_DOWN) ? 1 : 0;
+        int endX = x, endY = y;
+        while (board.fits(mask, endX + dx, endY + dy)) {
+            endX += dx;
+            endY += dy;
+        }
+
+        int end = dy ? endY : endX;
+        for (int cx = x, cy = y; ; cx += dx, cy += dy) {
+            slideMemo[direction][rotation][cy + Y_OFFSET][cx + X_OFFSET] = static_cast<uint8_t>(end + SLIDE_BIAS);
+            if (cx == endX && cy == endY) break;
+        }
+        return end;
+    }
+
+    void expand(const Bitboard& board, int type, size_t head, const Node& node) {
+        uint16_t parent = static_cast<uint16_t>(head);
+        int x = node.x, y = node.y, rotation = node.rotation;
+        const PieceMask& mask = pieceMask(type, rotation);
+
+        // Rotation state only matters for T-spin detection
+        auto translated = [&](int nx, int ny, MoveInput input) {
+            enqueue(nx, ny, rotation, 0, parent, input);
+        };
+
+        if (board.fits(mask, x - 1, y)) {
+            translated(x - 1, y, MOVE_LEFT);
+            int far = slide(board, mask, rotation, x - 1, y, SLIDE_LEFT);
+            if (far != x - 1) translated(far, y, MOVE_DAS_LEFT);
+        }
+        if (board.fits(mask, x + 1, y)) {
+            translated(x + 1, y, MOVE_RIGHT);
+            int far = slide(board, mask, rotation, x + 1, y, SLIDE_RIGHT);
+            if (far != x + 1) translated(far, y, MOVE_DAS_RIGHT);
+        }
+        if (board.fits(mask, x, y + 1)) {
+            translated(x, y + 1, MOVE_SOFT_DROP);
+            int floor = slide(board, mask, rotation, x, y + 1, SLIDE_DOWN);
+            if (floor != y + 1) translated(x, floor, MOVE_SONIC_DROP);
+        }
+
+        if (type == 3) return; // The O piece looks the same in every rotation
+
+        for (int direction : {-1, 1}) {
+            RotationResult turn = tryRotate(board, type, x, y, rotation, direction);
+            if (!turn.success) continue;
+
+            uint8_t flags = 0;
+            if (type == 5) flags = PLACEMENT_ROTATED | (turn.wallKick ? PLACEMENT_WALL_KICK : 0);
+            enqueue(turn.x, turn.y, turn.rotation, flags, parent, direction < 0 ? MOVE_ROTATE_CW : MOVE_ROTATE_CCW);
+        }
+    }
+
+    void addPlacement(const Bitboard& board, int type, size_t head, bool recordPaths) {
+        const Node& node = queue[head];
+
+        uint8_t flags = node.flags;
+        if ((flags & PLACEMENT_ROTATED) && countTSpinCorners(board, node.x, node.y) >= 3) {
+            flags |= PLACEMENT_TSPIN;
+        }
+        if (!(flags & PLACEMENT_TSPIN)) flags = 0; // Only a spin changes how the placement scores
+
+        uint64_t key = (cellKey(type, node.rotation, node.x, node.y) << 2 | (flags >> 1)) | (uint64_t(1) << 63);
+        size_t slot = (key * 0x9E3779B97F4A7C15ULL) >> 55; // Top 9 bits index KEY_SLOTS
+        while (placementKeys[slot] != 0) {
+            if (placementKeys[slot] == key) return;
+            slot = (slot + 1) % KEY_SLOTS;
+        }
+        if (placementCount >= MOVE_MAX_PLACEMENTS) return;
+        placementKeys[slot] = key;
+
+        Placement& placement = placements[placementCount++];
+        placement.x = node.x;
+        placement.y = node.y;
+        placement.rotation = node.rotation;
+        placement.flags = flags;
+        placement.pathLength = 0;
+        if (recordPaths) buildPath(head, placement);
+    }
+
+    void buildPath(size_t head, Placement& placement) {
+        MoveInput reversed[MOVE_MAX_PATH];
+        size_t length = 0;
+        for (uint16_t index = static_cast<uint16_t>(head); queue[index].parent != NO_PARENT; index = queue[index].parent) {
+            if (length == MOVE_MAX_PATH) return; // Too long to store; placement stays pathless
+            reversed[length++] = queue[index].input;
+        }
+
+        // The hard drop that follows makes a trailing sonic drop redundant
+        size_t start = (length > 0 && reversed[0] == MOVE_SONIC_DROP) ? 1 : 0;
+        placement.pathLength = static_cast<uint8_t>(length - start);
+        for (size_t i = 0; i < placement.pathLength; ++i) {
+            placement.path[i] = reversed[length - 1 - i];
+        }
+    }
+};
@@ -0,0 +1,298 @@
+/********************************************************************************
+ * File: perfect_clear.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Perfect-clear search for the Tetris Overlay. PerfectClearSolver looks
+ *   for a sequence that places the active piece, the preview queue and the
+ *   hold piece so that every filled cell of the board is cleared. It tries
+ *   each clear height from the top of the stack upwards, and every
+ *   placement has to stay inside the rows being cleared.
+ *
+ *   The search is a depth-first walk over reachable placements with three
+ *   bitboard prunings per node:
+ *   - The empty cells below the clear height must be a multiple of four and
+ *     need no more pieces than are left.
+ *   - Empty cells fall apart into regions that no piece can bridge, and
+ *     each region must be a multiple of four. Cells in one column count as
+ *     connected across filled cells, which a line clear could remove, so a
+ *     region is never split too eagerly.
+ *   - Column parity: the difference between empty cells in even and odd
+ *     columns must be one the remaining pieces can make up. Only I, J, L
+ *     and T pieces change it, and line clears never do.
+ *   Fields that failed are memoized by their packed rows, queue position
+ *   and hold slot, so a field reached by several move orders is searched
+ *   once.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "beam_search.hpp"
+#include "bitboard.hpp"
+#include "move_generator.hpp"
+
+constexpr int PERFECT_CLEAR_MAX_HEIGHT = 6;                     // Rows one clear may span; six rows pack into a 64-bit key
+constexpr int PERFECT_CLEAR_MAX_PIECES = SEARCH_PREVIEW_SIZE + 2; // Active piece, preview and hold
+
+struct PerfectClearResult {
+    bool found = false;
+    SearchMove first;     // Placement that starts the clear, ready for the hint or autoplay
+    int pieces = 0;       // Pieces the clear takes
+    int height = 0;       // Rows it clears
+    size_t nodes = 0;     // Fields visited
+};
+
+class PerfectClearSolver {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    size_t maxNodes = 20000; // Give up after this many fields even with time left
+
+    PerfectClearSolver() : failed(MEMO_SLOTS, 0) {}
+
+    // First move of a perfect clear from situation, if one exists and is found before deadline
+    template <typename CancelCheck>
+    PerfectClearResult solve(const SearchSituation& situation, Clock::time_point deadline, CancelCheck cancelled) {
+        PerfectClearResult result;
+        nodes = 0;
+        aborted = false;
+
+        int stack = stackHeight(situation.board);
+        if (stack == 0) return result; // Nothing to clear
+
+        sequenceLength = 0;
+        sequence[sequenceLength++] = situation.current.type;
+        for (int8_t type : situation.preview) {
+            if (type < 0) break;
+            sequence[sequenceLength++] = type;
+        }
+        root = &situation;
+        std::fill(failed.begin(), failed.end(), 0);
+
+        int filled = 0;
+        for (uint16_t row : situation.board.rows) filled += std::popcount(row);
+
+        for (int height = stack; height <= PERFECT_CLEAR_MAX_HEIGHT && !aborted; ++height) {
+            if ((height * BOARD_WIDTH - filled) % 4 != 0) continue;
+            if (search(situation.board, height, 0, situation.stored, situation.canHold, 0, deadline, cancelled)) {
+                result.found = true;
+                result.first = firstMove;
+                result.first.perfectClear = true;
+                result.pieces = solutionPieces;
+                result.height = height;
+                break;
+            }
+        }
+        result.nodes = nodes;
+        return result;
+    }
+
+private:
+    static constexpr size_t MEMO_SLOTS = 1 << 12;
+    static constexpr int HOLD_UNKNOWN = -2; // The hold slot took a piece from past the known queue
+
+    struct Candidate {
+        int8_t x, y;
+        uint8_t rotation;
+        uint8_t index; // Position in the generator's output, for the first move's path
+    };
+
+    MoveGenerator generator;
+    std::array<std::array<Candidate, MOVE_MAX_PLACEMENTS>, PERFECT_CLEAR_MAX_PIECES> candidates;
+    std::array<Placement, MOVE_MAX_PLACEMENTS> rootPlacements;
+    std::vector<uint64_t> failed; // Lossy set of field keys known to have no clear
+
+    const SearchSituation* root = nullptr;
+    std::array<int, SEARCH_PREVIEW_SIZE + 1> sequence{};
+    int sequenceLength = 0;
+    size_t nodes = 0;
+    bool aborted = false;
+    SearchMove firstMove;
+    int solutionPieces = 0;
+
+    static int stackHeight(const Bitboard& board) {
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            if (board.rows[y]) return BOARD_HEIGHT - y;
+        }
+        return 0;
+    }
+
+    // Rows below the clear height, ten bits each
+    static uint64_t packField(const Bitboard& board, int height) {
+        uint64_t packed = 0;
+        for (int y = BOARD_HEIGHT - height; y < BOARD_HEIGHT; ++y) packed = (packed << BOARD_WIDTH) | board.rows[y];
+        return packed;
+    }
+
+    static uint64_t mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    // Largest change to the even/odd column difference one piece can make (I, J, L, O, S, T, Z)
+    static int parityReach(int type) {
+        static constexpr int reach[7] = {4, 2, 2, 0, 0, 2, 0};
+        return (type >= 0 && type < 7) ? reach[type] : 0;
+    }
+
+    // Every region of empty cells below height holds a multiple of four cells
+    static bool regionsDivisible(const Bitboard& board, int height) {
+        int top = BOARD_HEIGHT - height;
+        std::array<uint16_t, PERFECT_CLEAR_MAX_HEIGHT> unvisited{};
+        for (int r = 0; r < height; ++r) unvisited[r] = uint16_t(~board.rows[top + r] & FULL_ROW);
+
+        std::array<uint8_t, PERFECT_CLEAR_MAX_HEIGHT * BOARD_WIDTH> stack;
+        for (int r0 = 0; r0 < height; ++r0) {
+            while (unvisited[r0]) {
+                int x0 = std::countr_zero(unvisited[r0]);
+                unvisited[r0] &= uint16_t(~(1u << x0));
+                size_t depth = 0, size = 0;
+                stack[depth++] = uint8_t(r0 * BOARD_WIDTH + x0);
+
+                while (depth) {
+                    int cell = stack[--depth];
+                    int r = cell / BOARD_WIDTH, x = cell % BOARD_WIDTH;
+                    size++;
+
+                    auto visit = [&](int nr, int nx) {
+                        if (unvisited[nr] & (1u << nx)) {
+                            unvisited[nr] &= uint16_t(~(1u << nx));
+                            stack[depth++] = uint8_t(nr * BOARD_WIDTH + nx);
+                        }
+                    };
+                    if (x > 0) visit(r, x - 1);
+                    if (x + 1 < BOARD_WIDTH) visit(r, x + 1);
+                    // Nearest empty cell above and below in the column; clears may close the gap
+                    for (int nr = r - 1; nr >= 0; --nr) {
+                        if (!(board.rows[top + nr] & (1u << x))) { visit(nr, x); break; }
+                    }
+                    for (int nr = r + 1; nr < height; ++nr) {
+                        if (!(board.rows[top + nr] & (1u << x))) { visit(nr, x); break; }
+                    }
+                }
+                if (size % 4 != 0) return false;
+            }
+        }
+        return true;
+    }
+
+    // Pieces that can still be placed from queue position index with hold
+    int piecesLeft(int index, int hold) const {
+        return (sequenceLength - index) + (hold >= 0 ? 1 : 0);
+    }
+
+    bool feasible(const Bitboard& board, int height, int index, int hold) const {
+        int top = BOARD_HEIGHT - height;
+        int empty = 0, parity = 0;
+        for (int y = top; y < BOARD_HEIGHT; ++y) {
+            uint16_t open = uint16_t(~board.rows[y] & FULL_ROW);
+            empty += std::popcount(open);
+            parity += std::popcount(uint16_t(open & EVEN_COLUMNS)) - std::popcount(uint16_t(open & ~EVEN_COLUMNS & FULL_ROW));
+        }
+        if (empty % 4 != 0 || empty / 4 > piecesLeft(index, hold)) return false;
+
+        int reach = (hold >= 0) ? parityReach(hold) : 0;
+        for (int i = index; i < sequenceLength; ++i) reach += parityReach(sequence[i]);
+        if (std::abs(parity) > reach) return false;
+
+        return regionsDivisible(board, height);
+    }
+
+    uint64_t memoKey(const Bitboard& board, int height, int index, int hold, bool canHold) const {
+        uint64_t state = uint64_t(height) | uint64_t(index) << 3 | uint64_t(hold + 2) << 6 | uint64_t(canHold) << 10;
+        return (mix(packField(board, height)) ^ mix(state * 0x9E3779B97F4A7C15ULL)) | 1;
+    }
+
+    // Placements of piece that stay below the clear height
+    size_t collect(const Bitboard& board, const Tetrimino& piece, int height, int depth) {
+        bool first = depth == 0;
+        generator.generate(board, piece, first);
+        size_t count = 0;
+        for (size_t i = 0; i < generator.size(); ++i) {
+            const Placement& placement = generator[i];
+            if (placement.y + pieceMask(piece.type, placement.rotation).top < BOARD_HEIGHT - height) continue;
+            candidates[depth][count++] = {placement.x, placement.y, placement.rotation, uint8_t(i)};
+            if (first) rootPlacements[i] = placement;
+        }
+        return count;
+    }
+
+    template <typename CancelCheck>
+    bool search(const Bitboard& board, int height, int index, int hold, bool canHold, int depth,
+                Clock::time_point deadline, CancelCheck& cancelled) {
+        if (height == 0) {
+            solutionPieces = depth;
+            return true;
+        }
+        if (aborted) return false;
+        if (++nodes >= maxNodes || ((nodes & 63) == 0 && (cancelled() || Clock::now() >= deadline))) {
+            aborted = true;
+            return false;
+        }
+        if (!feasible(board, height, index, hold)) return false;
+
+        uint64_t key = memoKey(board, height, index, hold, canHold);
+        uint64_t& slot = failed[key & (MEMO_SLOTS - 1)];
+        if (slot == key) return false;
+
+        // The active piece itself, the held piece swapped in, or the next piece after holding into an empty slot
+        if (index < sequenceLength) {
+            Tetrimino piece = (depth == 0) ? root->current : spawned(sequence[index]);
+            if (tryPiece(board, piece, height, index + 1, hold, false, depth, deadline, cancelled)) return true;
+        }
+        if (canHold && hold >= 0) {
+            int next = (index < sequenceLength) ? sequence[index] : HOLD_UNKNOWN;
+            if (tryPiece(board, Tetrimino(hold), height, index + 1, next, true, depth, deadline, cancelled)) return true;
+        }
+        if (canHold && hold == -1 && index + 1 < sequenceLength) {
+            Tetrimino piece = spawned(sequence[index + 1]);
+            if (tryPiece(board, piece, height, index + 2, sequence[index], true, depth, deadline, cancelled)) return true;
+        }
+
+        if (!aborted) slot = key;
+        return false;
+    }
+
+    template <typename CancelCheck>
+    bool tryPiece(const Bitboard& board, const Tetrimino& piece, int height, int nextIndex, int nextHold, bool useHold,
+                  int depth, Clock::time_point deadline, CancelCheck& cancelled) {
+        if (depth >= PERFECT_CLEAR_MAX_PIECES) return false;
+        size_t count = collect(board, piece, height, depth);
+        for (size_t i = 0; i < count && !aborted; ++i) {
+            const Candidate& candidate = candidates[depth][i];
+            Bitboard child = board;
+            child.place(piece.type, candidate.rotation, candidate.x, candidate.y);
+            int cleared = child.clearLines();
+            if (search(child, height - cleared, std::min(nextIndex, sequenceLength), nextHold, true, depth + 1, deadline, cancelled)) {
+                if (depth == 0) {
+                    firstMove = SearchMove();
+                    firstMove.found = true;
+                    firstMove.useHold = useHold;
+                    firstMove.type = piece.type;
+                    firstMove.placement = rootPlacements[candidate.index];
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static Tetrimino spawned(int type) {
+        Tetrimino piece(type);
+        placeAtSpawn(piece);
+        return piece;
+    }
+
+    static constexpr uint16_t EVEN_COLUMNS = 0x155; // Columns 0, 2, 4, 6, 8
+};
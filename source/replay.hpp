@@ -0,0 +1,327 @@
+/********************************************************************************
+ * File: replay.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Input replay recording and playback for the Tetris Overlay. A replay is the
+ *   piece seed followed by one record per input frame, so a game can be re-run
+ *   through the engine bit-exactly to reproduce desyncs or serve as a
+ *   benchmark workload.
+ *
+ *   Stream layout (little-endian):
+ *   - Header: "TRPL", u16 version, u16 flags, u64 seed, u32 frame count,
+ *     u32 stream size, u32 final state hash.
+ *   - Frames: varint((deltaMs << 2) | changeFlags), followed by the held button
+ *     mask if bit 0 is set and the pressed button mask if bit 1 is set. Frames
+ *     without a button change at 60 fps cost a single byte.
+ *   - Keyframes (version 2): engine state blobs captured every
+ *     REPLAY_KEYFRAME_INTERVAL pieces, followed by an index table and a
+ *     trailer (u32 index offset, u32 keyframe count, "TKIX"). Seeking restores
+ *     the nearest keyframe and simulates forward, so its cost does not grow
+ *     with the length of the replay.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+// Buttons captured by the replay, packed into one byte per mask
+enum ReplayButton : uint8_t {
+    REPLAY_LEFT  = 1 << 0,
+    REPLAY_RIGHT = 1 << 1,
+    REPLAY_DOWN  = 1 << 2,
+    REPLAY_UP    = 1 << 3,
+    REPLAY_A     = 1 << 4,
+    REPLAY_B     = 1 << 5,
+    REPLAY_L     = 1 << 6,
+    REPLAY_PLUS  = 1 << 7
+};
+
+constexpr uint32_t REPLAY_MAGIC = 0x4C505254; // "TRPL"
+constexpr uint32_t REPLAY_INDEX_MAGIC = 0x58494B54; // "TKIX"
+constexpr uint16_t REPLAY_VERSION = 2;
+constexpr size_t REPLAY_HEADER_SIZE = 28;
+constexpr size_t REPLAY_INDEX_ENTRY_SIZE = 29;
+constexpr size_t REPLAY_TRAILER_SIZE = 12;
+constexpr uint32_t REPLAY_KEYFRAME_INTERVAL = 100; // Pieces between keyframes
+
+// Header flags
+constexpr uint16_t REPLAY_FLAG_INITIAL_KEYFRAME = 1 << 0; // Starts from keyframe 0 instead of a fresh game
+
+// One decoded input frame
+struct ReplayFrame {
+    uint32_t deltaMs;  // Time since the previous frame
+    uint8_t held;      // Buttons held during this frame
+    uint8_t down;      // Buttons newly pressed during this frame
+};
+
+// Engine state at a frame boundary; the blob is opaque to the replay code
+struct ReplayKeyframe {
+    uint32_t pieceIndex;    // Pieces spawned when the keyframe was taken
+    uint32_t frameIndex;    // Frames preceding the keyframe
+    uint32_t streamOffset;  // Stream position of the next frame
+    uint64_t clockMs;       // Replay time of the keyframe
+    uint8_t prevHeld;       // Held mask of the preceding frame
+    std::vector<uint8_t> state;
+};
+
+// Little-endian helpers shared by the replay writer and reader
+inline void putLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+inline uint64_t getLE(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Returns false if the varint runs past the end of the buffer
+inline bool getVarint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+
+class ReplayRecorder {
+public:
+    bool isRecording() const { return recording; }
+    uint64_t getSeed() const { return seed; }
+    uint32_t getFrameCount() const { return frameCount; }
+
+    void start(uint64_t gameSeed, uint16_t headerFlags = 0) {
+        recording = true;
+        seed = gameSeed;
+        flags = headerFlags;
+        frameCount = 0;
+        clockMs = 0;
+        prevHeld = 0;
+        stream.clear();
+        stream.reserve(16 * 1024);
+        keyframes.clear();
+    }
+
+    // Attach the engine state reached after the frames recorded so far
+    void addKeyframe(uint32_t pieceIndex, std::vector<uint8_t> state) {
+        if (!recording) return;
+        keyframes.push_back({pieceIndex, frameCount, static_cast<uint32_t>(stream.size()), clockMs, prevHeld, std::move(state)});
+    }
+
+    void stop() { recording = false; }
+
+    // Append one input frame; held/down are REPLAY_* masks
+    void record(uint32_t deltaMs, uint8_t held, uint8_t down) {
+        if (!recording) return;
+
+        uint8_t expectedDown = held & ~prevHeld;
+        uint64_t changeFlags = (held != prevHeld ? 1 : 0) | (down != expectedDown ? 2 : 0);
+
+        putVarint(stream, (static_cast<uint64_t>(deltaMs) << 2) | changeFlags);
+        if (changeFlags & 1) stream.push_back(held);
+        if (changeFlags & 2) stream.push_back(down);
+
+        prevHeld = held;
+        clockMs += deltaMs;
+        frameCount++;
+    }
+
+    // Serialize the header, stream and keyframe index; stateHash lets playback detect desyncs
+    std::vector<uint8_t> serialize(uint32_t stateHash) const {
+        std::vector<uint8_t> header;
+        header.reserve(REPLAY_HEADER_SIZE + stream.size());
+        putLE(header, REPLAY_MAGIC, 4);
+        putLE(header, REPLAY_VERSION, 2);
+        putLE(header, flags, 2);
+        putLE(header, seed, 8);
+        putLE(header, frameCount, 4);
+        putLE(header, stream.size(), 4);
+        putLE(header, stateHash, 4);
+
+        // Keyframe blobs go right after the stream, the index table at the very end
+        std::vector<uint8_t> tail;
+        std::vector<uint32_t> blobOffsets;
+        uint32_t offset = static_cast<uint32_t>(REPLAY_HEADER_SIZE + stream.size());
+        for (const auto& keyframe : keyframes) {
+            blobOffsets.push_back(offset + static_cast<uint32_t>(tail.size()));
+            tail.insert(tail.end(), keyframe.state.begin(), keyframe.state.end());
+        }
+        uint32_t indexOffset = offset + static_cast<uint32_t>(tail.size());
+        for (size_t i = 0; i < keyframes.size(); ++i) {
+            const auto& keyframe = keyframes[i];
+            putLE(tail, keyframe.pieceIndex, 4);
+            putLE(tail, keyframe.frameIndex, 4);
+            putLE(tail, keyframe.streamOffset, 4);
+            putLE(tail, keyframe.clockMs, 8);
+            putLE(tail, keyframe.prevHeld, 1);
+            putLE(tail, blobOffsets[i], 4);
+            putLE(tail, keyframe.state.size(), 4);
+        }
+        putLE(tail, indexOffset, 4);
+        putLE(tail, keyframes.size(), 4);
+        putLE(tail, REPLAY_INDEX_MAGIC, 4);
+
+        header.insert(header.end(), stream.begin(), stream.end());
+        header.insert(header.end(), tail.begin(), tail.end());
+        return header;
+    }
+
+private:
+    bool recording = false;
+    uint64_t seed = 0;
+    uint16_t flags = 0;
+    uint32_t frameCount = 0;
+    uint64_t clockMs = 0;
+    uint8_t prevHeld = 0;
+    std::vector<uint8_t> stream;
+    std::vector<ReplayKeyframe> keyframes;
+};
+
+
+class ReplayReader {
+public:
+    uint64_t getSeed() const { return seed; }
+    uint16_t getFlags() const { return flags; }
+    uint32_t getFrameCount() const { return frameCount; }
+    uint32_t getFramesRead() const { return framesRead; }
+    uint32_t getStateHash() const { return stateHash; }
+    uint64_t getClockMs() const { return clockMs; }
+    const std::vector<ReplayKeyframe>& getKeyframes() const { return keyframes; }
+    bool atEnd() const { return framesRead >= frameCount || pos >= stream.size(); }
+
+    bool loadFromFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        if (data.size() < REPLAY_HEADER_SIZE) return false;
+        uint16_t version = static_cast<uint16_t>(getLE(data.data() + 4, 2));
+        if (getLE(data.data(), 4) != REPLAY_MAGIC || version < 1 || version > REPLAY_VERSION) return false;
+
+        flags = static_cast<uint16_t>(getLE(data.data() + 6, 2));
+        seed = getLE(data.data() + 8, 8);
+        frameCount = static_cast<uint32_t>(getLE(data.data() + 16, 4));
+        uint32_t streamSize = static_cast<uint32_t>(getLE(data.data() + 20, 4));
+        stateHash = static_cast<uint32_t>(getLE(data.data() + 24, 4));
+
+        if (data.size() - REPLAY_HEADER_SIZE < streamSize) return false;
+        stream.assign(data.begin() + REPLAY_HEADER_SIZE, data.begin() + REPLAY_HEADER_SIZE + streamSize);
+
+        keyframes.clear();
+        if (version >= 2 && !loadKeyframes(data)) return false;
+        if ((flags & REPLAY_FLAG_INITIAL_KEYFRAME) && (keyframes.empty() || keyframes.front().frameIndex != 0)) return false;
+
+        rewind();
+        return true;
+    }
+
+    void rewind() {
+        pos = 0;
+        framesRead = 0;
+        clockMs = 0;
+        prevHeld = 0;
+    }
+
+    // Latest keyframe at or before the given replay time (nullptr if there is none)
+    const ReplayKeyframe* findKeyframe(uint64_t targetMs) const {
+        auto it = std::upper_bound(keyframes.begin(), keyframes.end(), targetMs,
+            [](uint64_t ms, const ReplayKeyframe& keyframe) { return ms < keyframe.clockMs; });
+        return (it == keyframes.begin()) ? nullptr : &*(it - 1);
+    }
+
+    // Continue decoding right after the given keyframe
+    void seekTo(const ReplayKeyframe& keyframe) {
+        pos = keyframe.streamOffset;
+        framesRead = keyframe.frameIndex;
+        clockMs = keyframe.clockMs;
+        prevHeld = keyframe.prevHeld;
+    }
+
+    // Decode the next frame; returns false at the end of the stream or on corruption
+    bool next(ReplayFrame& frame) {
+        if (atEnd()) return false;
+
+        uint64_t header;
+        if (!getVarint(stream, pos, header)) return false;
+
+        frame.deltaMs = static_cast<uint32_t>(header >> 2);
+        frame.held = prevHeld;
+        if (header & 1) {
+            if (pos >= stream.size()) return false;
+            frame.held = stream[pos++];
+        }
+        frame.down = frame.held & ~prevHeld;
+        if (header & 2) {
+            if (pos >= stream.size()) return false;
+            frame.down = stream[pos++];
+        }
+
+        prevHeld = frame.held;
+        clockMs += frame.deltaMs;
+        framesRead++;
+        return true;
+    }
+
+private:
+    uint64_t seed = 0;
+    uint16_t flags = 0;
+    uint32_t frameCount = 0;
+    uint32_t stateHash = 0;
+    uint32_t framesRead = 0;
+    uint64_t clockMs = 0;
+    uint8_t prevHeld = 0;
+    size_t pos = 0;
+    std::vector<uint8_t> stream;
+    std::vector<ReplayKeyframe> keyframes;
+
+    bool loadKeyframes(const std::vector<uint8_t>& data) {
+        if (data.size() < REPLAY_HEADER_SIZE + stream.size() + REPLAY_TRAILER_SIZE) return false;
+        const uint8_t* trailer = data.data() + data.size() - REPLAY_TRAILER_SIZE;
+        if (getLE(trailer + 8, 4) != REPLAY_INDEX_MAGIC) return false;
+
+        uint64_t indexOffset = getLE(trailer, 4);
+        uint64_t count = getLE(trailer + 4, 4);
+        if (indexOffset + count * REPLAY_INDEX_ENTRY_SIZE > data.size() - REPLAY_TRAILER_SIZE) return false;
+
+        keyframes.reserve(count);
+        const uint8_t* entry = data.data() + indexOffset;
+        for (uint64_t i = 0; i < count; ++i, entry += REPLAY_INDEX_ENTRY_SIZE) {
+            ReplayKeyframe keyframe;
+            keyframe.pieceIndex = static_cast<uint32_t>(getLE(entry, 4));
+            keyframe.frameIndex = static_cast<uint32_t>(getLE(entry + 4, 4));
+            keyframe.streamOffset = static_cast<uint32_t>(getLE(entry + 8, 4));
+            keyframe.clockMs = getLE(entry + 12, 8);
+            keyframe.prevHeld = static_cast<uint8_t>(getLE(entry + 20, 1));
+            uint64_t blobOffset = getLE(entry + 21, 4);
+            uint64_t blobSize = getLE(entry + 25, 4);
+            if (blobOffset + blobSize > indexOffset || keyframe.streamOffset > stream.size()) return false;
+            keyframe.state.assign(data.begin() + blobOffset, data.begin() + blobOffset + blobSize);
+            keyframes.push_back(std::move(keyframe));
+        }
+        return true;
+    }
+};
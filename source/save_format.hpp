@@ -0,0 +1,369 @@
+/********************************************************************************
+ * File: save_format.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Compact, versioned binary encoding of the Tetris Overlay game state. Used
+ *   for the save file and for replay keyframes. A typical mid-game record is
+ *   around 100 bytes and decodes without any heap allocation.
+ *
+ *   Record layout (little-endian):
+ *   - Header: "TSAV", u8 version, u8 reserved, u16 payload size.
+ *   - Payload (bit-packed, LSB first): see encodeSaveState().
+ *   - Trailer: u32 CRC-32 over header and payload.
+ *
+ *   Compatibility: readers decode the fields they know and ignore trailing
+ *   payload bytes, so new fields are appended without a version bump. An
+ *   incompatible layout bumps SAVE_FORMAT_VERSION and adds a decoder for the
+ *   old version that upgrades into the current GameSnapshot.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "handling.hpp"
+#include "game_phase.hpp"
+
+constexpr uint32_t SAVE_FORMAT_MAGIC = 0x56415354; // "TSAV"
+constexpr uint8_t SAVE_FORMAT_VERSION = 1;
+constexpr size_t SAVE_HEADER_SIZE = 8;
+constexpr size_t SAVE_TRAILER_SIZE = 4;
+
+constexpr int SAVE_BOARD_WIDTH = 10;
+constexpr int SAVE_BOARD_HEIGHT = 20;
+
+// Complete simulation state at a frame boundary. Timestamps are stored in
+// milliseconds relative to the frame clock.
+struct GameSnapshot {
+    std::array<std::array<int8_t, SAVE_BOARD_WIDTH>, SAVE_BOARD_HEIGHT> board;
+    std::array<std::array<int8_t, 4>, 5> pieces; // type, x, y, rotation of current, next, next1, next2, stored
+    uint64_t rngState;
+    uint64_t seed;
+    uint64_t score;
+    int32_t linesCleared;
+    int32_t level;
+    int32_t linesClearedForLevelUp;
+    int32_t backToBackCount;
+    int32_t lockDelayMoves;
+    int32_t totalSoftDropDistance;
+    int32_t hardDropDistance;
+    uint32_t piecesSpawned;
+    int64_t lockDelayCounterMs;
+    int64_t fallCounterMs;
+    int64_t lastRotationOrMoveMs;
+    int64_t lastFrameMs;
+    int64_t lastLeftMoveMs;
+    int64_t lastRightMoveMs;
+    int64_t lastDownMoveMs;
+    uint16_t flags;
+    int32_t combo;            // Appended after the board; -1 when an older record lacks it
+    HandlingSettings handling; // Appended after combo; Classic when an older record lacks it
+    uint8_t phase;            // GamePhase, appended after handling; Falling when an older record lacks it
+    int64_t phaseDeadlineMs;  // End of the line-clear or entry delay
+    uint8_t entryInput;       // EntryInput presses kept for the next piece
+};
+
+enum SnapshotFlag : uint16_t {
+    SNAPSHOT_PAUSED          = 1 << 0,
+    SNAPSHOT_GAME_OVER       = 1 << 1,
+    SNAPSHOT_HAS_SWAPPED     = 1 << 2,
+    SNAPSHOT_WALL_KICK       = 1 << 3,
+    SNAPSHOT_PREV_TETRIS     = 1 << 4,
+    SNAPSHOT_PREV_TSPIN      = 1 << 5,
+    SNAPSHOT_KICKED_UP       = 1 << 6,
+    SNAPSHOT_LEFT_HELD       = 1 << 7,
+    SNAPSHOT_RIGHT_HELD      = 1 << 8,
+    SNAPSHOT_DOWN_HELD       = 1 << 9,
+    SNAPSHOT_LEFT_ARR        = 1 << 10,
+    SNAPSHOT_RIGHT_ARR       = 1 << 11,
+    SNAPSHOT_DOWN_ARR        = 1 << 12,
+    SNAPSHOT_ROTATED_LAST    = 1 << 13,
+    SNAPSHOT_FAR_KICK        = 1 << 14,
+    SNAPSHOT_RIGHT_PRIORITY  = 1 << 15
+};
+
+
+// CRC-32 (IEEE 802.3), table generated at compile time
+constexpr std::array<uint32_t, 256> makeCrc32Table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> crc32Table = makeCrc32Table();
+
+inline uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = crc32Table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void write(uint64_t value, int bits) {
+        for (int i = 0; i < bits; ++i) {
+            if (bitPos == 0) out.push_back(0);
+            out.back() |= static_cast<uint8_t>(((value >> i) & 1) << bitPos);
+            bitPos = (bitPos + 1) & 7;
+        }
+    }
+
+    void writeVarint(uint64_t value) {
+        while (value >= 0x80) {
+            write((value & 0x7F) | 0x80, 8);
+            value >>= 7;
+        }
+        write(value, 8);
+    }
+
+    // Zigzag keeps small negative offsets small
+    void writeSignedVarint(int64_t value) {
+        writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    int bitPos = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    bool failed() const { return overflow; }
+    size_t bitsLeft() const { return size * 8 - pos; }
+
+    uint64_t read(int bits) {
+        uint64_t value = 0;
+        for (int i = 0; i < bits; ++i) {
+            if (pos >= size * 8) {
+                overflow = true;
+                return 0;
+            }
+            value |= static_cast<uint64_t>((data[pos >> 3] >> (pos & 7)) & 1) << i;
+            pos++;
+        }
+        return value;
+    }
+
+    uint64_t readVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint64_t byte = read(8);
+            value |= (byte & 0x7F) << shift;
+            if (!(byte & 0x80) || overflow) return value;
+        }
+        overflow = true;
+        return value;
+    }
+
+    int64_t readSignedVarint() {
+        uint64_t value = readVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    bool overflow = false;
+};
+
+
+// Serialize a snapshot; maxHighScore rides along for the save file (keyframes pass 0)
+inline std::vector<uint8_t> encodeSaveState(const GameSnapshot& snapshot, uint64_t maxHighScore) {
+    std::vector<uint8_t> record = {
+        static_cast<uint8_t>(SAVE_FORMAT_MAGIC), static_cast<uint8_t>(SAVE_FORMAT_MAGIC >> 8),
+        static_cast<uint8_t>(SAVE_FORMAT_MAGIC >> 16), static_cast<uint8_t>(SAVE_FORMAT_MAGIC >> 24),
+        SAVE_FORMAT_VERSION, 0, 0, 0
+    };
+    record.reserve(128);
+
+    BitWriter writer(record);
+    writer.writeVarint(maxHighScore);
+    writer.write(snapshot.flags, 16);
+
+    // Pieces: 3-bit type (7 = none), 2-bit rotation, offset 4-bit x and 5-bit y
+    for (const auto& piece : snapshot.pieces) {
+        writer.write(piece[0] < 0 ? 7 : piece[0], 3);
+        writer.write(piece[3], 2);
+        writer.write(piece[1] + 4, 4);
+        writer.write(piece[2] + 4, 5);
+    }
+
+    writer.write(snapshot.rngState, 64);
+    writer.write(snapshot.seed, 64);
+
+    writer.writeVarint(snapshot.score);
+    writer.writeVarint(snapshot.linesCleared);
+    writer.writeVarint(snapshot.level);
+    writer.writeVarint(snapshot.linesClearedForLevelUp);
+    writer.writeVarint(snapshot.backToBackCount);
+    writer.writeVarint(snapshot.lockDelayMoves);
+    writer.writeVarint(snapshot.totalSoftDropDistance);
+    writer.writeVarint(snapshot.hardDropDistance);
+    writer.writeVarint(snapshot.piecesSpawned);
+
+    writer.writeSignedVarint(snapshot.lockDelayCounterMs);
+    writer.writeSignedVarint(snapshot.fallCounterMs);
+    writer.writeSignedVarint(snapshot.lastRotationOrMoveMs);
+    writer.writeSignedVarint(snapshot.lastFrameMs);
+    writer.writeSignedVarint(snapshot.lastLeftMoveMs);
+    writer.writeSignedVarint(snapshot.lastRightMoveMs);
+    writer.writeSignedVarint(snapshot.lastDownMoveMs);
+
+    // Board: skip empty rows at the top, then a 10-bit occupancy mask per row,
+    // then a 3-bit color for every occupied cell
+    int emptyRows = 0;
+    while (emptyRows < SAVE_BOARD_HEIGHT) {
+        bool rowEmpty = true;
+        for (int8_t cell : snapshot.board[emptyRows]) {
+            if (cell != 0) rowEmpty = false;
+        }
+        if (!rowEmpty) break;
+        emptyRows++;
+    }
+    writer.write(emptyRows, 5);
+    for (int y = emptyRows; y < SAVE_BOARD_HEIGHT; ++y) {
+        for (int x = 0; x < SAVE_BOARD_WIDTH; ++x) {
+            writer.write(snapshot.board[y][x] != 0, 1);
+        }
+    }
+    for (int y = emptyRows; y < SAVE_BOARD_HEIGHT; ++y) {
+        for (int x = 0; x < SAVE_BOARD_WIDTH; ++x) {
+            if (snapshot.board[y][x] != 0) writer.write(snapshot.board[y][x] - 1, 3);
+        }
+    }
+
+    writer.writeSignedVarint(snapshot.combo);
+
+    // Handling: field count, then one varint per field in HANDLING_FIELD_NAMES order
+    auto handlingFields = toHandlingFields(snapshot.handling);
+    writer.writeVarint(handlingFields.size());
+    for (uint16_t field : handlingFields) writer.writeVarint(field);
+
+    writer.writeVarint(snapshot.phase);
+    writer.writeSignedVarint(snapshot.phaseDeadlineMs);
+    writer.writeVarint(snapshot.entryInput);
+
+    size_t payloadSize = record.size() - SAVE_HEADER_SIZE;
+    record[6] = static_cast<uint8_t>(payloadSize);
+    record[7] = static_cast<uint8_t>(payloadSize >> 8);
+
+    uint32_t crc = crc32(record.data(), record.size());
+    for (int i = 0; i < 4; ++i) {
+        record.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+    }
+    return record;
+}
+
+// Version 1 payload decoder
+inline bool decodeSaveStateV1(BitReader& reader, GameSnapshot& snapshot, uint64_t& maxHighScore) {
+    maxHighScore = reader.readVarint();
+    snapshot.flags = static_cast<uint16_t>(reader.read(16));
+
+    for (auto& piece : snapshot.pieces) {
+        int type = static_cast<int>(reader.read(3));
+        piece[0] = static_cast<int8_t>(type == 7 ? -1 : type);
+        piece[3] = static_cast<int8_t>(reader.read(2));
+        piece[1] = static_cast<int8_t>(static_cast<int>(reader.read(4)) - 4);
+        piece[2] = static_cast<int8_t>(static_cast<int>(reader.read(5)) - 4);
+    }
+
+    snapshot.rngState = reader.read(64);
+    snapshot.seed = reader.read(64);
+
+    snapshot.score = reader.readVarint();
+    snapshot.linesCleared = static_cast<int32_t>(reader.readVarint());
+    snapshot.level = static_cast<int32_t>(reader.readVarint());
+    snapshot.linesClearedForLevelUp = static_cast<int32_t>(reader.readVarint());
+    snapshot.backToBackCount = static_cast<int32_t>(reader.readVarint());
+    snapshot.lockDelayMoves = static_cast<int32_t>(reader.readVarint());
+    snapshot.totalSoftDropDistance = static_cast<int32_t>(reader.readVarint());
+    snapshot.hardDropDistance = static_cast<int32_t>(reader.readVarint());
+    snapshot.piecesSpawned = static_cast<uint32_t>(reader.readVarint());
+
+    snapshot.lockDelayCounterMs = reader.readSignedVarint();
+    snapshot.fallCounterMs = reader.readSignedVarint();
+    snapshot.lastRotationOrMoveMs = reader.readSignedVarint();
+    snapshot.lastFrameMs = reader.readSignedVarint();
+    snapshot.lastLeftMoveMs = reader.readSignedVarint();
+    snapshot.lastRightMoveMs = reader.readSignedVarint();
+    snapshot.lastDownMoveMs = reader.readSignedVarint();
+
+    int emptyRows = static_cast<int>(reader.read(5));
+    if (emptyRows > SAVE_BOARD_HEIGHT) return false;
+    for (auto& row : snapshot.board) row.fill(0);
+    for (int y = emptyRows; y < SAVE_BOARD_HEIGHT; ++y) {
+        for (int x = 0; x < SAVE_BOARD_WIDTH; ++x) {
+            snapshot.board[y][x] = static_cast<int8_t>(reader.read(1));
+        }
+    }
+    for (int y = emptyRows; y < SAVE_BOARD_HEIGHT; ++y) {
+        for (int x = 0; x < SAVE_BOARD_WIDTH; ++x) {
+            if (snapshot.board[y][x] != 0) snapshot.board[y][x] = static_cast<int8_t>(reader.read(3) + 1);
+        }
+    }
+    if (reader.failed()) return false;
+
+    // Fields appended since the first version; a varint takes at least a byte
+    snapshot.combo = (reader.bitsLeft() >= 8) ? static_cast<int32_t>(reader.readSignedVarint()) : -1;
+
+    // Fields this build does not know are read and dropped; missing ones stay Classic
+    auto handlingFields = toHandlingFields(CLASSIC_HANDLING);
+    size_t handlingCount = (reader.bitsLeft() >= 8) ? static_cast<size_t>(reader.readVarint()) : 0;
+    for (size_t i = 0; i < handlingCount && !reader.failed(); ++i) {
+        uint64_t field = reader.readVarint();
+        if (i < handlingFields.size()) handlingFields[i] = static_cast<uint16_t>(field);
+    }
+    snapshot.handling = fromHandlingFields(handlingFields);
+
+    snapshot.phase = PHASE_FALLING;
+    snapshot.phaseDeadlineMs = 0;
+    snapshot.entryInput = 0;
+    if (reader.bitsLeft() >= 24) {
+        snapshot.phase = static_cast<uint8_t>(reader.readVarint());
+        snapshot.phaseDeadlineMs = reader.readSignedVarint();
+        snapshot.entryInput = static_cast<uint8_t>(reader.readVarint());
+        if (snapshot.phase > PHASE_ENTRY) return false;
+    }
+    return !reader.failed();
+}
+
+// Validate and decode a record of any known version into the current snapshot layout
+inline bool decodeSaveState(const uint8_t* data, size_t size, GameSnapshot& snapshot, uint64_t& maxHighScore) {
+    if (size < SAVE_HEADER_SIZE + SAVE_TRAILER_SIZE) return false;
+
+    uint32_t magic = data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    size_t payloadSize = data[6] | (data[7] << 8);
+    if (magic != SAVE_FORMAT_MAGIC || SAVE_HEADER_SIZE + payloadSize + SAVE_TRAILER_SIZE != size) return false;
+
+    const uint8_t* trailer = data + SAVE_HEADER_SIZE + payloadSize;
+    uint32_t storedCrc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<uint32_t>(trailer[3]) << 24);
+    if (crc32(data, SAVE_HEADER_SIZE + payloadSize) != storedCrc) return false;
+
+    BitReader reader(data + SAVE_HEADER_SIZE, payloadSize);
+    switch (data[4]) {
+        case 1:
+            return decodeSaveStateV1(reader, snapshot, maxHighScore);
+        default:
+            return false; // Written by a newer, incompatible build
+    }
+}
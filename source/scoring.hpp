@@ -0,0 +1,127 @@
+/********************************************************************************
+ * File: scoring.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Guideline scoring for the Tetris Overlay. Every locked piece goes through
+ *   scoreLock() with the lines it cleared, its T-spin class and whether it
+ *   left the board empty. The points and banner come from constexpr tables
+ *   keyed by spin class and line count; back-to-back, combo and perfect-clear
+ *   bonuses are applied on top and everything is multiplied by the level.
+ *
+ *   - Difficult clears (Tetrises and T-spins that clear lines) pay half again
+ *     when the previous clear was difficult too. T-spins without lines keep
+ *     the chain alive without extending it; any other clear breaks it.
+ *   - Each consecutive locking piece that clears lines adds 50 per combo step.
+ *   - A perfect clear adds a bonus by line count, larger after back-to-back.
+ *
+ *   Only integer arithmetic is used, so the same lock always scores the same
+ *   on every build, which keeps replays and self-play benchmarks stable.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "tspin.hpp"
+
+enum ClearBanner : uint8_t {
+    BANNER_NONE,
+    BANNER_SINGLE,
+    BANNER_DOUBLE,
+    BANNER_TRIPLE,
+    BANNER_TETRIS,
+    BANNER_MINI_TSPIN,
+    BANNER_MINI_TSPIN_SINGLE,
+    BANNER_MINI_TSPIN_DOUBLE,
+    BANNER_TSPIN,
+    BANNER_TSPIN_SINGLE,
+    BANNER_TSPIN_DOUBLE,
+    BANNER_TSPIN_TRIPLE,
+    BANNER_COUNT
+};
+
+// Banner text; multi-line entries are drawn one line under the other
+constexpr std::array<const char*, BANNER_COUNT> CLEAR_BANNER_TEXT = {{
+    "", "Single", "Double", "Triple", "Tetris",
+    "Mini\nT-Spin", "Mini T-Spin\nSingle", "Mini T-Spin\nDouble",
+    "T-Spin", "T-Spin\nSingle", "T-Spin\nDouble", "T-Spin\nTriple"
+}};
+
+struct ClearAction {
+    uint16_t points;     // Before back-to-back and level
+    ClearBanner banner;
+    bool difficult;      // Starts or continues a back-to-back chain
+};
+
+// By spin class, then lines cleared. A mini never clears three rows and a T never clears four,
+// so those slots repeat the nearest reachable action.
+constexpr std::array<std::array<ClearAction, 5>, 3> CLEAR_ACTIONS = {{
+    {{  // TSPIN_NONE
+        {0, BANNER_NONE, false}, {100, BANNER_SINGLE, false}, {300, BANNER_DOUBLE, false},
+        {500, BANNER_TRIPLE, false}, {800, BANNER_TETRIS, true}
+    }},
+    {{  // TSPIN_MINI
+        {100, BANNER_MINI_TSPIN, false}, {200, BANNER_MINI_TSPIN_SINGLE, true}, {400, BANNER_MINI_TSPIN_DOUBLE, true},
+        {1600, BANNER_TSPIN_TRIPLE, true}, {1600, BANNER_TSPIN_TRIPLE, true}
+    }},
+    {{  // TSPIN_FULL
+        {400, BANNER_TSPIN, false}, {800, BANNER_TSPIN_SINGLE, true}, {1200, BANNER_TSPIN_DOUBLE, true},
+        {1600, BANNER_TSPIN_TRIPLE, true}, {1600, BANNER_TSPIN_TRIPLE, true}
+    }}
+}};
+
+// Perfect-clear bonus by lines cleared, and for a back-to-back Tetris that empties the board
+constexpr std::array<uint16_t, 5> PERFECT_CLEAR_POINTS = {{0, 800, 1200, 1800, 2000}};
+constexpr uint16_t PERFECT_CLEAR_B2B_TETRIS_POINTS = 3200;
+constexpr int COMBO_POINTS = 50;
+
+// Chain state carried from one lock to the next
+struct ScoringState {
+    bool previousClearWasTetris = false;
+    bool previousClearWasTSpin = false;
+    int backToBackCount = 1;  // Difficult clears in the current chain
+    int combo = -1;           // Consecutive clearing locks minus one; -1 after a lock that cleared nothing
+};
+
+struct LockScore {
+    int points = 0;          // Already multiplied by the level
+    ClearBanner banner = BANNER_NONE;
+    bool backToBack = false;
+    bool perfectClear = false;
+    int combo = -1;
+};
+
+// Score one locked piece and advance state
+constexpr LockScore scoreLock(ScoringState& state, int lines, TSpinType spin, bool perfectClear, int level) {
+    LockScore result;
+    if (lines < 0 || lines > 4) lines = 0;
+    const ClearAction& action = CLEAR_ACTIONS[spin][lines];
+    result.banner = action.banner;
+
+    if (lines == 0) {
+        state.combo = -1;
+        result.points = action.points * level;
+        return result;
+    }
+
+    state.combo++;
+    result.combo = state.combo;
+    result.backToBack = action.difficult && (state.previousClearWasTetris || state.previousClearWasTSpin);
+    state.backToBackCount = result.backToBack ? state.backToBackCount + 1 : 1;
+    state.previousClearWasTetris = action.difficult && lines == 4 && spin == TSPIN_NONE;
+    state.previousClearWasTSpin = action.difficult && !state.previousClearWasTetris;
+
+    int points = action.points;
+    if (result.backToBack) points = points * 3 / 2;
+    points += COMBO_POINTS * state.combo;
+    if (perfectClear) {
+        result.perfectClear = true;
+        points += (result.backToBack && lines == 4) ? PERFECT_CLEAR_B2B_TETRIS_POINTS : PERFECT_CLEAR_POINTS[lines];
+    }
+    result.points = points * level;
+    return result;
+}
@@ -0,0 +1,58 @@
+/********************************************************************************
+ * File: search_arena.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Bump allocator for the Tetris Overlay's search code. One block is sized
+ *   up front and rewound at the start of every search, so node storage is
+ *   handed out by moving an offset instead of going through the heap.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+class SearchArena {
+public:
+    // Bytes needed for count objects of T, including worst-case alignment padding
+    template <typename T>
+    static constexpr size_t bytesFor(size_t count) {
+        return sizeof(T) * count + alignof(T);
+    }
+
+    // Drop everything allocated so far; the block only grows when bytes exceeds it
+    void reset(size_t bytes) {
+        if (bytes > capacity) {
+            buffer.reset(new std::byte[bytes]);
+            capacity = bytes;
+        }
+        used = 0;
+    }
+
+    // Default-constructed array of count objects, or nullptr when the block is full.
+    // Nothing is ever destroyed, so only trivially destructible types are allowed.
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+
+        size_t offset = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (offset + sizeof(T) * count > capacity) return nullptr;
+        used = offset + sizeof(T) * count;
+
+        T* items = reinterpret_cast<T*>(buffer.get() + offset);
+        std::uninitialized_default_construct_n(items, count);
+        return items;
+    }
+
+    size_t bytesUsed() const { return used; }
+
+private:
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity = 0;
+    size_t used = 0;
+};
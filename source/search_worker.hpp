@@ -0,0 +1,136 @@
+/********************************************************************************
+ * File: search_worker.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Background thread for the Tetris Overlay's placement search. SearchWorker
+ *   runs BeamSearch off the UI thread: submitting a new situation cancels the
+ *   running search, every search stops at its deadline with the best move
+ *   found so far, and neither submit() nor poll() ever blocks the caller.
+ *   Before the beam search, the worker looks for a perfect clear; when there
+ *   is one, its first placement is the result instead.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "beam_search.hpp"
+#include "perfect_clear.hpp"
+
+// Runs BeamSearch on a background thread. The caller submits a situation
+// whenever it changes and polls once per frame; a late result simply shows up
+// on a later poll, and a result for an outdated situation is never returned.
+class SearchWorker {
+public:
+    SearchWorker() {
+        search.pool = &pool;
+        thread = std::thread(&SearchWorker::run, this);
+    }
+
+    ~SearchWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        generation++;
+        wake.notify_one();
+        thread.join();
+    }
+
+    // Start searching situation, cancelling whatever is running. Without
+    // placementSearch only a perfect clear is looked for, and the result is not
+    // found unless there is one. Returns false (and changes nothing) if the worker
+    // happens to hold the lock; retry next frame.
+    bool submit(const SearchSituation& situation, std::chrono::milliseconds budget, bool placementSearch = true) {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock()) return false;
+
+        pending = situation;
+        pendingBudget = budget;
+        pendingPlacementSearch = placementSearch;
+        pendingGeneration = ++generation;
+        hasPending = true;
+        hasResult = false;
+        lock.unlock();
+        wake.notify_one();
+        return true;
+    }
+
+    // Drop the pending or running search without starting a new one
+    void cancel() {
+        generation++;
+    }
+
+    // Fetch a finished result for the latest submitted situation, if there is one
+    bool poll(SearchMove& move) {
+        std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+        if (!lock.owns_lock() || !hasResult) return false;
+
+        hasResult = false;
+        if (resultGeneration != generation.load()) return false;
+        move = result;
+        return true;
+    }
+
+    BeamSearch& searcher() { return search; } // Only touch while no search is running
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<uint32_t> generation{0};
+    bool stopping = false;
+
+    SearchSituation pending;
+    std::chrono::milliseconds pendingBudget{0};
+    bool pendingPlacementSearch = true;
+    uint32_t pendingGeneration = 0;
+    bool hasPending = false;
+
+    SearchMove result;
+    uint32_t resultGeneration = 0;
+    bool hasResult = false;
+
+    ThreadPool pool;    // Helpers for the search thread; none on the console
+    BeamSearch search;
+    PerfectClearSolver perfectClear;
+    std::thread thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || hasPending; });
+            if (stopping) break;
+
+            SearchSituation situation = pending;
+            uint32_t id = pendingGeneration;
+            auto start = BeamSearch::Clock::now();
+            auto deadline = start + pendingBudget;
+            bool placementSearch = pendingPlacementSearch;
+            hasPending = false;
+            if (id != generation.load()) continue; // Cancelled before it started
+
+            lock.unlock();
+            auto cancelled = [this, id] { return generation.load() != id; };
+            // A perfect clear may use half the budget; it gives up quickly on boards that have none
+            auto clearDeadline = placementSearch ? start + pendingBudget / 2 : deadline;
+            PerfectClearResult clear = perfectClear.solve(situation, clearDeadline, cancelled);
+            SearchMove move = clear.first;
+            if (!clear.found && placementSearch) move = search.run(situation, deadline, cancelled);
+            lock.lock();
+
+            if (id == generation.load()) {
+                result = move;
+                resultGeneration = id;
+                hasResult = true;
+            }
+        }
+    }
+};
@@ -0,0 +1,241 @@
+/********************************************************************************
+ * File: tetrimino.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Piece shapes, rotation rules and SRS kick tables for the Tetris Overlay.
+ *   Kept free of any Tesla dependency so the move generator and host-side
+ *   tools follow exactly the same rules as the overlay.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// Define the Tetrimino shapes
+const std::array<std::array<size_t, 16>, 7> tetriminoShapes = {{
+    // I
+    { 0,0,0,0,
+      1,1,1,1,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // J
+    { 1,0,0,0,
+      1,1,1,0,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // L
+    { 0,0,1,0,
+      1,1,1,0,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // O
+    { 1,1,0,0,
+      1,1,0,0,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // S
+    { 0,1,1,0,
+      1,1,0,0,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // T
+    { 0,1,0,0,
+      1,1,1,0,
+      0,0,0,0,
+      0,0,0,0 },
+
+    // Z
+    { 1,1,0,0,
+      0,1,1,0,
+      0,0,0,0,
+      0,0,0,0 }
+}};
+
+// Adjusted rotation centers based on official Tetris SRS
+const std::array<std::pair<int, int>, 7> rotationCenters = {{
+    {1.5f, 1.5f}, // I piece (rotating around the second cell in a 4x4 grid)
+    {1, 1}, // J piece
+    {1, 1}, // L piece
+    {1, 1}, // O piece
+    {1, 1}, // S piece
+    {1, 1}, // T piece
+    {1, 1}  // Z piece
+}};
+
+// Wall kicks for I piece (SRS)
+const std::array<std::array<std::pair<int, int>, 5>, 4> wallKicksI = {{
+    // 0 -> 1, 1 -> 0
+    {{ {0, 0}, {-2, 0}, {1, 0}, {-2, -1}, {1, 2} }},
+    // 1 -> 2, 2 -> 1
+    {{ {0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1} }},
+    // 2 -> 3, 3 -> 2
+    {{ {0, 0}, {2, 0}, {-1, 0}, {2, 1}, {-1, -2} }},
+    // 3 -> 0, 0 -> 3
+    {{ {0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1} }}
+}};
+
+// Wall kicks for J, L, S, T, Z pieces (SRS)
+const std::array<std::array<std::pair<int, int>, 5>, 4> wallKicksJLSTZ = {{
+    // 0 -> 1, 1 -> 0
+    {{ {0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2} }},
+    // 1 -> 2, 2 -> 1
+    {{ {0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2} }},
+    // 2 -> 3, 3 -> 2
+    {{ {0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2} }},
+    // 3 -> 0, 0 -> 3
+    {{ {0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2} }}
+}};
+
+// Fallback offsets tried in tight spaces once every standard kick has failed
+const std::array<std::pair<int, int>, 7> extraKicks = {{ {0, 1}, {0, -1}, {1, 0}, {-1, 0}, {0, 2}, {2, 0}, {-2, 0} }};
+
+// Board dimensions
+const int BOARD_WIDTH = 10;
+const int BOARD_HEIGHT = 20;
+
+// Updated helper function to get rotated index
+inline int getRotatedIndex(int type, int i, int j, int rotation) {
+    // Ensure i and j are within bounds
+    if (i < 0 || i >= 4 || j < 0 || j >= 4) return -1;
+
+    if (type == 0) { // I piece
+        int rotatedIndex = 0;
+        switch (rotation) {
+            case 0: rotatedIndex = i * 4 + j; break;
+            case 1: rotatedIndex = (3 - i) + j * 4; break;
+            case 2: rotatedIndex = (3 - j) + (3 - i) * 4; break;
+            case 3: rotatedIndex = i + (3 - j) * 4; break;
+        }
+        return rotatedIndex;
+    } else if (type == 3) { // O piece doesn't rotate
+        return i * 4 + j;
+    } else {
+        // General case for other pieces
+        float centerX = rotationCenters[type].first;
+        float centerY = rotationCenters[type].second;
+        int relX = j - centerX;
+        int relY = i - centerY;
+        int rotatedX = 0, rotatedY = 0;
+
+        switch (rotation) {
+            case 0: rotatedX = relX; rotatedY = relY; break;
+            case 1: rotatedX = -relY; rotatedY = relX; break;
+            case 2: rotatedX = -relX; rotatedY = -relY; break;
+            case 3: rotatedX = relY; rotatedY = -relX; break;
+        }
+
+        int finalX = static_cast<int>(round(rotatedX + centerX));
+        int finalY = static_cast<int>(round(rotatedY + centerY));
+
+        // Ensure the rotated index is within the 4x4 grid
+        if (finalX < 0 || finalX >= 4 || finalY < 0 || finalY >= 4) return -1;
+        return finalY * 4 + finalX;
+    }
+}
+
+struct Tetrimino {
+    int x, y;
+    int type;
+    int rotation;
+    Tetrimino(int t) : x(BOARD_WIDTH / 2 - 2), y(0), type(t), rotation(0) {}
+};
+
+constexpr uint8_t ALL_PIECE_TYPES = 0x7F; // One bit per piece type
+
+// Seeded piece generator (xorshift64*), kept apart from rand() so particle effects
+// never disturb the piece sequence of a recorded game
+struct PieceRandomizer {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    void seed(uint64_t s) {
+        state = s ? s : 0x9E3779B97F4A7C15ULL; // xorshift must never hold a zero state
+    }
+
+    int next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<int>(((state * 0x2545F4914F6CDD1DULL) >> 32) % 7);
+    }
+
+    // Types the next call can deal, each equally likely. Every draw is independent, so that
+    // is all seven; a bag randomizer would report the types left in its bag.
+    uint8_t possibleNext() const { return ALL_PIECE_TYPES; }
+};
+
+// Center a freshly spawned Tetrimino horizontally with its top row on the board edge
+inline void placeAtSpawn(Tetrimino& tet) {
+    int minX = 4, maxX = -1;
+    int topmostRow = 4;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            int rotatedIndex = getRotatedIndex(tet.type, i, j, tet.rotation);
+            if (rotatedIndex >= 0 && tetriminoShapes[tet.type][rotatedIndex] != 0) {
+                minX = std::min(minX, j);
+                maxX = std::max(maxX, j);
+                topmostRow = std::min(topmostRow, i);
+            }
+        }
+    }
+    tet.x = (BOARD_WIDTH - (maxX - minX + 1)) / 2 - minX;
+    tet.y = -topmostRow;  // Allow the piece to start partially off-screen if necessary
+}
+
+// Function to check if the current position of a Tetrimino is valid
+inline bool isPositionValid(const Tetrimino& tet, const std::array<std::array<int, BOARD_WIDTH>, BOARD_HEIGHT>& board) {
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            int rotatedIndex = getRotatedIndex(tet.type, i, j, tet.rotation);
+
+            // Only check cells that contain a block
+            if (tetriminoShapes[tet.type][rotatedIndex] != 0) {
+                int x = tet.x + j;
+                int y = tet.y + i;
+
+                // Check if x and y are within the bounds of the board horizontally
+                if (x < 0 || x >= BOARD_WIDTH) {
+                    return false;  // Invalid if out of bounds
+                }
+
+                // Allow blocks above the board but not below the bottom
+                if (y >= BOARD_HEIGHT) {
+                    return false;  // Invalid if out of bounds vertically
+                }
+
+                // If the block is above the visible board, ignore it
+                if (y < 0) {
+                    continue;  // Skip rows above the board
+                }
+
+                // Check if the block space is occupied
+                if (board[y][x] != 0) {
+                    return false;  // Invalid if space is occupied
+                }
+            }
+        }
+    }
+    return true;  // Position is valid
+}
+
+// Helper function to calculate where the Tetrimino will land if hard dropped
+inline int calculateDropDistance(const Tetrimino& tet, const std::array<std::array<int, BOARD_WIDTH>, BOARD_HEIGHT>& board) {
+    int dropDistance = 0;
+    Tetrimino tempTetrimino = tet;  // Create a temporary copy for simulation
+    while (isPositionValid(tempTetrimino, board)) {
+        tempTetrimino.y += 1;  // Move down one row
+        dropDistance++;
+    }
+    return std::max(dropDistance - 1, 0);  // Ensure the dropDistance doesn't go negative
+}
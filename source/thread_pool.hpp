@@ -0,0 +1,216 @@
+/********************************************************************************
+ * File: thread_pool.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Small work-stealing task scheduler for the Tetris Overlay's search code.
+ *   Every thread has its own fixed-size ring of tasks: a thread pushes and
+ *   pops work at the back of its own ring and steals from the front of the
+ *   others when it runs dry. A thread waiting on a TaskGroup runs queued
+ *   tasks instead of sleeping, so the pool's concurrency counts the waiting
+ *   thread too.
+ *
+ *   A task is a plain record (function pointer, context pointer and index),
+ *   so submitting one never allocates. A thread that finds its ring full
+ *   runs tasks from it until there is room again, while the other threads
+ *   keep stealing from the front.
+ *
+ *   On the console the search already runs on a background thread of its
+ *   own, which is the one core the overlay spends on it. The pool adds no
+ *   threads there, and tasks run on that thread as it waits.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <array>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Shared stop flag for a batch of tasks; tasks check it and return early
+class CancelToken {
+public:
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+    void reset() { flag.store(false, std::memory_order_relaxed); }
+    bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> flag{false};
+};
+
+// Tasks that are waited for together
+class TaskGroup {
+public:
+    CancelToken token;
+
+private:
+    friend class ThreadPool;
+    std::atomic<size_t> pending{0};
+};
+
+class ThreadPool {
+public:
+    // Threads that run tasks, counting the one that waits; the console gets only the waiting thread
+    static size_t defaultConcurrency() {
+    #if defined(__SWITCH__)
+        return 1;
+    #else
+        return std::max(1u, std::thread::hardware_concurrency());
+    #endif
+    }
+
+    explicit ThreadPool(size_t concurrency = defaultConcurrency())
+        : queues(std::max<size_t>(concurrency, 1)) {
+        for (size_t lane = 1; lane < queues.size(); ++lane) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, lane);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t concurrency() const { return queues.size(); }
+
+    // Index of the calling thread: 1.. for pool threads, 0 for any other thread.
+    // Per-thread scratch space can be indexed with it, so only one outside thread
+    // should submit and wait on a pool at a time.
+    static size_t currentLane() { return lane(); }
+
+    using TaskFunction = void (*)(void* context, size_t index);
+
+    // Queue run(context, index); context must stay valid until the group is waited for
+    void submit(TaskGroup& group, TaskFunction run, void* context, size_t index) {
+        Queue& queue = queues[ownLane()];
+        while (!push(queue, {&group, run, context, index})) {
+            // Ring full: work it down on this thread, outside the lock, then try again
+            if (!runOne()) {
+                run(context, index);
+                return;
+            }
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        if (!workers.empty()) {
+            // Taking the lock orders this against a worker that is about to sleep
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            wake.notify_one();
+        }
+    }
+
+    // Queue body(i) for every i below count; body must outlive the wait on group
+    template <typename Body>
+    void submitEach(TaskGroup& group, size_t count, Body& body) {
+        for (size_t i = 0; i < count; ++i) submit(group, &invokeBody<Body>, &body, i);
+    }
+
+    // Run tasks until every task of group has finished
+    void wait(TaskGroup& group) {
+        while (group.pending.load(std::memory_order_acquire) > 0) {
+            if (!runOne()) std::this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr size_t QUEUE_CAPACITY = 256;
+
+    struct Task {
+        TaskGroup* group;
+        TaskFunction run;
+        void* context;
+        size_t index;
+    };
+
+    // Ring of tasks: the oldest at head, the newest at head + count - 1
+    struct Queue {
+        std::mutex mutex;
+        std::array<Task, QUEUE_CAPACITY> tasks;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    template <typename Body>
+    static void invokeBody(void* body, size_t index) { (*static_cast<Body*>(body))(index); }
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static size_t& lane() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    size_t ownLane() const { return std::min(lane(), queues.size() - 1); }
+
+    // Append task at the back of queue unless the ring is full
+    static bool push(Queue& queue, const Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.count == QUEUE_CAPACITY) return false;
+        task.group->pending.fetch_add(1, std::memory_order_relaxed);
+        queue.tasks[(queue.head + queue.count) % QUEUE_CAPACITY] = task;
+        queue.count++;
+        return true;
+    }
+
+    // Newest task from this thread's ring, else the oldest one from another's
+    bool runOne() {
+        size_t own = ownLane();
+        Task task;
+        bool found = false;
+        {
+            Queue& queue = queues[own];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.count > 0) {
+                queue.count--;
+                task = queue.tasks[(queue.head + queue.count) % QUEUE_CAPACITY];
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        for (size_t offset = 1; !found && offset < queues.size(); ++offset) {
+            Queue& victim = queues[(own + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.count > 0) {
+                task = victim.tasks[victim.head];
+                victim.head = (victim.head + 1) % QUEUE_CAPACITY;
+                victim.count--;
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        if (!found) return false;
+
+        task.run(task.context, task.index);
+        task.group->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        lane() = index;
+        while (true) {
+            if (runOne()) continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping) break;
+        }
+    }
+};
@@ -0,0 +1,65 @@
+/********************************************************************************
+ * File: transposition_table.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Fixed-size, lock-free hash table for the Tetris Overlay's search code.
+ *   Each slot holds a 64-bit payload next to its key XORed with that
+ *   payload. A slot torn by two concurrent writers no longer decodes to
+ *   its key and reads as a miss, so threads can share the table without
+ *   locks. Colliding writes replace the older entry; the table never grows.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+class TranspositionTable {
+public:
+    // slotCount is rounded down to a power of two
+    explicit TranspositionTable(size_t slotCount) {
+        size_t size = 1;
+        while (size * 2 <= slotCount) size *= 2;
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        clear();
+    }
+
+    bool probe(uint64_t key, uint64_t& data) const {
+        const Slot& slot = slots[key & mask];
+        uint64_t stored = slot.data.load(std::memory_order_relaxed);
+        if ((slot.check.load(std::memory_order_relaxed) ^ stored) != key) return false;
+        data = stored;
+        return true;
+    }
+
+    void store(uint64_t key, uint64_t data) {
+        Slot& slot = slots[key & mask];
+        slot.data.store(data, std::memory_order_relaxed);
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    // Not safe against concurrent probes or stores
+    void clear() {
+        for (size_t i = 0; i <= mask; ++i) {
+            // An all-zero slot would decode as key 0, so empty slots get a check that never matches
+            slots[i].data.store(0, std::memory_order_relaxed);
+            slots[i].check.store(~uint64_t(i), std::memory_order_relaxed);
+        }
+    }
+
+    size_t size() const { return mask + 1; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0}; // key ^ data
+        std::atomic<uint64_t> data{0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+};
@@ -0,0 +1,95 @@
+/********************************************************************************
+ * File: tspin.hpp
+ * Author: ppkantorski
+ * Description:
+ *   T-spin classification for the Tetris Overlay, run once when a T piece
+ *   locks. It follows the three-corner rule: the last successful action was
+ *   a rotation and at least three of the four cells diagonal to the T's
+ *   center are blocked. With both corners on the pointed side blocked it is
+ *   a full T-spin, otherwise a mini, unless the rotation needed the kick
+ *   that moves the piece two rows, which always makes it full.
+ *
+ *   The corners on the pointed (front) and flat (back) side of each
+ *   rotation are worked out once from the piece masks.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "bitboard.hpp"
+
+constexpr int T_PIECE = 5;
+
+enum TSpinType : uint8_t {
+    TSPIN_NONE,
+    TSPIN_MINI,
+    TSPIN_FULL
+};
+
+// Corner bits around the T's center, which sits at (x + 1, y + 1) of the piece position
+enum TSpinCorner : uint8_t {
+    CORNER_TOP_LEFT     = 1 << 0,
+    CORNER_TOP_RIGHT    = 1 << 1,
+    CORNER_BOTTOM_LEFT  = 1 << 2,
+    CORNER_BOTTOM_RIGHT = 1 << 3
+};
+
+struct TSpinCornerMasks {
+    uint8_t front = 0; // Corners beside the T's point
+    uint8_t back = 0;  // Corners beside its flat side
+};
+
+using TSpinCornerTable = std::array<TSpinCornerMasks, 4>;
+
+// The point faces away from the one side of the center the T does not cover
+inline TSpinCornerTable buildTSpinCornerTable() {
+    TSpinCornerTable table{};
+    for (int rotation = 0; rotation < 4; ++rotation) {
+        const PieceMask& mask = pieceMask(T_PIECE, rotation);
+        auto covered = [&](int column, int row) {
+            return row >= mask.top && row <= mask.bottom && column >= mask.minCol &&
+                   ((mask.rows[row] >> (column - mask.minCol)) & 1);
+        };
+
+        uint8_t front;
+        if (!covered(1, 2)) front = CORNER_TOP_LEFT | CORNER_TOP_RIGHT;
+        else if (!covered(1, 0)) front = CORNER_BOTTOM_LEFT | CORNER_BOTTOM_RIGHT;
+        else if (!covered(0, 1)) front = CORNER_TOP_RIGHT | CORNER_BOTTOM_RIGHT;
+        else front = CORNER_TOP_LEFT | CORNER_BOTTOM_LEFT;
+
+        table[rotation].front = front;
+        table[rotation].back = uint8_t(~front & 0xF);
+    }
+    return table;
+}
+
+inline const TSpinCornerMasks& tSpinCornerMasks(int rotation) {
+    static const TSpinCornerTable table = buildTSpinCornerTable();
+    return table[rotation & 3];
+}
+
+// Blocked corners of a T at (x, y); blocked(column, row) also answers for cells off the board
+template <typename Blocked>
+uint8_t tSpinCorners(int x, int y, Blocked blocked) {
+    return uint8_t((blocked(x, y) ? CORNER_TOP_LEFT : 0) | (blocked(x + 2, y) ? CORNER_TOP_RIGHT : 0) |
+                   (blocked(x, y + 2) ? CORNER_BOTTOM_LEFT : 0) | (blocked(x + 2, y + 2) ? CORNER_BOTTOM_RIGHT : 0));
+}
+
+inline uint8_t tSpinCorners(const Bitboard& board, int x, int y) {
+    return tSpinCorners(x, y, [&](int cx, int cy) {
+        return cx < 0 || cx >= BOARD_WIDTH || cy < 0 || cy >= BOARD_HEIGHT || board.isFilled(cx, cy);
+    });
+}
+
+// corners from tSpinCorners() on the board the piece locks into, before any line clears
+inline TSpinType classifyTSpin(int type, int rotation, uint8_t corners, bool rotatedLast, bool farKick) {
+    if (type != T_PIECE || !rotatedLast || std::popcount(corners) < 3) return TSPIN_NONE;
+    uint8_t front = tSpinCornerMasks(rotation).front;
+    return ((corners & front) == front || farKick) ? TSPIN_FULL : TSPIN_MINI;
+}
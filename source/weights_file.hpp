@@ -0,0 +1,117 @@
+/********************************************************************************
+ * File: weights_file.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Compact binary file for evaluator weights. The weight tuner writes its
+ *   best EvalWeights here and the overlay loads them at startup for its hint
+ *   and autoplay searches; without a valid file the built-in defaults stay.
+ *
+ *   File layout (little-endian):
+ *   - Header: "TWGT", u8 version, u8 weight count, u16 reserved.
+ *   - Weights: count IEEE-754 float32 values in EvalWeights field order.
+ *   - Trailer: u32 CRC-32 over header and weights.
+ *
+ *   Compatibility: new weights are appended to the end of the order. A reader
+ *   takes the weights it knows and keeps its defaults for the ones a shorter
+ *   file lacks.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "evaluator.hpp"
+#include "replay.hpp"
+#include "save_format.hpp"
+
+constexpr uint32_t WEIGHTS_FILE_MAGIC = 0x54475754; // "TWGT"
+constexpr uint8_t WEIGHTS_FILE_VERSION = 1;
+constexpr size_t WEIGHTS_HEADER_SIZE = 8;
+// One row per evaluator weight, in file order; the count, the names and both
+// conversions below all come from this table
+struct EvalWeightField {
+    const char* name;
+    float& (*access)(EvalWeights&);
+};
+
+constexpr std::array<EvalWeightField, 15> EVAL_WEIGHT_FIELDS = {{
+    {"aggregateHeight",   [](EvalWeights& w) -> float& { return w.aggregateHeight; }},
+    {"maxHeight",         [](EvalWeights& w) -> float& { return w.maxHeight; }},
+    {"holes",             [](EvalWeights& w) -> float& { return w.holes; }},
+    {"bumpiness",         [](EvalWeights& w) -> float& { return w.bumpiness; }},
+    {"wells",             [](EvalWeights& w) -> float& { return w.wells; }},
+    {"deepestWell",       [](EvalWeights& w) -> float& { return w.deepestWell; }},
+    {"rowTransitions",    [](EvalWeights& w) -> float& { return w.rowTransitions; }},
+    {"columnTransitions", [](EvalWeights& w) -> float& { return w.columnTransitions; }},
+    {"tSlots",            [](EvalWeights& w) -> float& { return w.tSlots; }},
+    {"lineClear0",        [](EvalWeights& w) -> float& { return w.lineClears[0]; }},
+    {"lineClear1",        [](EvalWeights& w) -> float& { return w.lineClears[1]; }},
+    {"lineClear2",        [](EvalWeights& w) -> float& { return w.lineClears[2]; }},
+    {"lineClear3",        [](EvalWeights& w) -> float& { return w.lineClears[3]; }},
+    {"lineClear4",        [](EvalWeights& w) -> float& { return w.lineClears[4]; }},
+    {"tSpinClear",        [](EvalWeights& w) -> float& { return w.tSpinClear; }}
+}};
+
+constexpr size_t EVAL_WEIGHT_COUNT = EVAL_WEIGHT_FIELDS.size();
+
+// EvalWeights holds nothing but floats, so a weight added there without a row here fails to build
+static_assert(sizeof(EvalWeights) == EVAL_WEIGHT_COUNT * sizeof(float),
+              "every EvalWeights member needs a row in EVAL_WEIGHT_FIELDS");
+
+using WeightVector = std::array<float, EVAL_WEIGHT_COUNT>;
+
+// Names in file order, for tools and logs
+constexpr std::array<const char*, EVAL_WEIGHT_COUNT> EVAL_WEIGHT_NAMES = [] {
+    std::array<const char*, EVAL_WEIGHT_COUNT> names{};
+    for (size_t i = 0; i < EVAL_WEIGHT_COUNT; ++i) names[i] = EVAL_WEIGHT_FIELDS[i].name;
+    return names;
+}();
+
+inline WeightVector toWeightVector(EvalWeights weights) {
+    WeightVector values{};
+    for (size_t i = 0; i < EVAL_WEIGHT_COUNT; ++i) values[i] = EVAL_WEIGHT_FIELDS[i].access(weights);
+    return values;
+}
+
+inline EvalWeights fromWeightVector(const WeightVector& values) {
+    EvalWeights weights;
+    for (size_t i = 0; i < EVAL_WEIGHT_COUNT; ++i) EVAL_WEIGHT_FIELDS[i].access(weights) = values[i];
+    return weights;
+}
+
+inline std::vector<uint8_t> encodeWeights(const EvalWeights& weights) {
+    std::vector<uint8_t> out;
+    out.reserve(WEIGHTS_HEADER_SIZE + EVAL_WEIGHT_COUNT * 4 + 4);
+    putLE(out, WEIGHTS_FILE_MAGIC, 4);
+    putLE(out, WEIGHTS_FILE_VERSION, 1);
+    putLE(out, EVAL_WEIGHT_COUNT, 1);
+    putLE(out, 0, 2);
+    for (float value : toWeightVector(weights)) putLE(out, std::bit_cast<uint32_t>(value), 4);
+    putLE(out, crc32(out.data(), out.size()), 4);
+    return out;
+}
+
+// Leaves weights untouched unless the whole file checks out
+inline bool decodeWeights(const uint8_t* data, size_t size, EvalWeights& weights) {
+    if (size < WEIGHTS_HEADER_SIZE + 4) return false;
+    if (getLE(data, 4) != WEIGHTS_FILE_MAGIC || data[4] != WEIGHTS_FILE_VERSION) return false;
+
+    size_t count = data[5];
+    if (size != WEIGHTS_HEADER_SIZE + count * 4 + 4) return false;
+    if (getLE(data + size - 4, 4) != crc32(data, size - 4)) return false;
+
+    WeightVector values = toWeightVector(weights);
+    for (size_t i = 0; i < count && i < values.size(); ++i) {
+        values[i] = std::bit_cast<float>(static_cast<uint32_t>(getLE(data + WEIGHTS_HEADER_SIZE + i * 4, 4)));
+        if (!std::isfinite(values[i])) return false;
+    }
+    weights = fromWeightVector(values);
+    return true;
+}
@@ -0,0 +1,93 @@
+/********************************************************************************
+ * File: zobrist.hpp
+ * Author: ppkantorski
+ * Description:
+ *   Zobrist hashing for the Tetris Overlay's search code. Every board cell has
+ *   a fixed 64-bit key and a board hashes to the XOR of the keys of its filled
+ *   cells, so locking a piece updates the hash with four XORs. Extra keys
+ *   cover the hold slot, the queue position and the set of possible next
+ *   pieces for hashing search nodes. The keys are generated at compile time
+ *   and never change between runs.
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "bitboard.hpp"
+
+constexpr size_t ZOBRIST_HOLD_KEYS = 8;   // Empty hold slot plus the seven piece types
+constexpr size_t ZOBRIST_QUEUE_KEYS = 8;  // Queue positions a search node can reach
+constexpr size_t ZOBRIST_PIECE_SET_KEYS = 128; // Masks over the seven piece types
+
+// splitmix64, a fixed sequence of well-mixed keys
+constexpr uint64_t zobristMix(uint64_t index) {
+    uint64_t z = (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+struct ZobristKeys {
+    std::array<std::array<uint64_t, BOARD_WIDTH>, BOARD_HEIGHT> cells{};
+    std::array<uint64_t, ZOBRIST_HOLD_KEYS> hold{};
+    std::array<uint64_t, ZOBRIST_QUEUE_KEYS> queue{};
+    std::array<uint64_t, ZOBRIST_PIECE_SET_KEYS> pieceSets{};
+};
+
+constexpr ZobristKeys buildZobristKeys() {
+    ZobristKeys keys;
+    uint64_t index = 0;
+    for (auto& row : keys.cells) {
+        for (uint64_t& key : row) key = zobristMix(index++);
+    }
+    for (uint64_t& key : keys.hold) key = zobristMix(index++);
+    for (uint64_t& key : keys.queue) key = zobristMix(index++);
+    for (uint64_t& key : keys.pieceSets) key = zobristMix(index++);
+    return keys;
+}
+
+inline constexpr ZobristKeys zobristKeys = buildZobristKeys();
+
+// XOR of the keys of the filled cells of one row
+inline uint64_t zobristRow(int y, uint16_t row) {
+    uint64_t hash = 0;
+    for (; row; row &= row - 1) hash ^= zobristKeys.cells[y][std::countr_zero(row)];
+    return hash;
+}
+
+inline uint64_t zobristHash(const Bitboard& board) {
+    uint64_t hash = 0;
+    for (int y = 0; y < BOARD_HEIGHT; ++y) hash ^= zobristRow(y, board.rows[y]);
+    return hash;
+}
+
+// Change to a board's hash from locking a piece; cells above the board are not stored and do not count
+inline uint64_t zobristPiece(int type, int rotation, int x, int y) {
+    const PieceMask& mask = pieceMask(type, rotation);
+    int left = x + mask.minCol;
+    uint64_t hash = 0;
+    for (int i = mask.top; i <= mask.bottom; ++i) {
+        if (y + i >= 0) hash ^= zobristRow(y + i, uint16_t(mask.rows[i] << left));
+    }
+    return hash;
+}
+
+// Hold slot contents, -1 for empty
+inline uint64_t zobristHold(int type) {
+    return zobristKeys.hold[type + 1];
+}
+
+inline uint64_t zobristQueue(int index) {
+    return zobristKeys.queue[index % ZOBRIST_QUEUE_KEYS];
+}
+
+// Set of piece types (bit per type) a chance node averages over
+inline uint64_t zobristPieceSet(uint8_t mask) {
+    return zobristKeys.pieceSets[mask & (ZOBRIST_PIECE_SET_KEYS - 1)];
+}
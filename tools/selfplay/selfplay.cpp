@@ -0,0 +1,186 @@
+/********************************************************************************
+ * File: selfplay.cpp
+ * Author: ppkantorski
+ * Description:
+ *   Headless self-play benchmark for the Tetris Overlay's engine and search.
+ *   Plays seeded bot games on the HeadlessGame rules, one game per pool
+ *   task across every core, and reports simulation throughput along with
+ *   line, score and top-out statistics. Runs are reproducible: game i uses
+ *   seed + i and the search runs at a fixed depth and width unless a
+ *   per-move budget is given.
+ *
+ *   Usage: selfplay [--games N] [--pieces N] [--threads N] [--seed N]
+ *                   [--width N] [--depth N] [--budget-ms N] [--no-expectimax]
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "beam_search.hpp"
+#include "headless_game.hpp"
+#include "thread_pool.hpp"
+
+struct Options {
+    size_t games = 100;
+    int pieceLimit = 10000;     // A game that survives this long counts as finished
+    size_t threads = ThreadPool::defaultConcurrency();
+    uint64_t seed = 1;
+    int width = 16;
+    int depth = SEARCH_PREVIEW_SIZE + 1;
+    int budgetMs = 0;           // 0: fixed width and no deadline
+    bool expectimax = true;
+};
+
+struct GameResult {
+    uint64_t score = 0;
+    int lines = 0;
+    int pieces = 0;
+    std::array<int, 5> clears{};
+    int tSpinClears = 0;
+    int perfectClears = 0;
+    TopOutCause topOut = TOP_OUT_NONE;
+};
+
+static const char* topOutNames[TOP_OUT_CAUSE_COUNT] = {"survived", "block out", "lock out", "no move"};
+
+static void printUsage() {
+    std::printf("usage: selfplay [--games N] [--pieces N] [--threads N] [--seed N]\n"
+                "                [--width N] [--depth N] [--budget-ms N] [--no-expectimax]\n");
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--no-expectimax") == 0) {
+            options.expectimax = false;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+
+        long long value = std::atoll(argv[++i]);
+        if (value < 0) return false;
+        if (std::strcmp(arg, "--games") == 0) options.games = size_t(value);
+        else if (std::strcmp(arg, "--pieces") == 0) options.pieceLimit = int(value);
+        else if (std::strcmp(arg, "--threads") == 0) options.threads = std::max<size_t>(1, size_t(value));
+        else if (std::strcmp(arg, "--seed") == 0) options.seed = uint64_t(value);
+        else if (std::strcmp(arg, "--width") == 0) options.width = std::max(1, int(value));
+        else if (std::strcmp(arg, "--depth") == 0) options.depth = std::max(1, int(value));
+        else if (std::strcmp(arg, "--budget-ms") == 0) options.budgetMs = int(value);
+        else return false;
+    }
+    return true;
+}
+
+static GameResult playGame(BeamSearch& search, const Options& options, uint64_t seed) {
+    HeadlessGame game;
+    game.reset(seed);
+
+    while (!game.over() && game.pieces < options.pieceLimit) {
+        auto now = BeamSearch::Clock::now();
+        auto deadline = options.budgetMs > 0 ? now + std::chrono::milliseconds(options.budgetMs) : BeamSearch::Clock::time_point::max();
+        SearchMove move = search.run(game.situation(), deadline, [] { return false; });
+        game.play(move);
+    }
+
+    GameResult result;
+    result.score = game.score;
+    result.lines = game.lines;
+    result.pieces = game.pieces;
+    result.clears = game.clears;
+    result.tSpinClears = game.tSpinClears;
+    result.perfectClears = game.perfectClears;
+    result.topOut = game.topOut;
+    return result;
+}
+
+template <typename T>
+static T percentile(const std::vector<T>& sorted, double fraction) {
+    if (sorted.empty()) return T();
+    size_t index = std::min(sorted.size() - 1, size_t(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    // One search per pool thread; each game runs its search single-threaded
+    ThreadPool pool(options.threads);
+    std::vector<std::unique_ptr<BeamSearch>> searches(pool.concurrency());
+    for (auto& search : searches) {
+        search = std::make_unique<BeamSearch>(BeamSearch::HOST_TABLE_SLOTS);
+        search->beamWidth = options.width;
+        search->maxBeamWidth = std::max(options.width, search->maxBeamWidth);
+        search->maxDepth = options.depth;
+        search->expectimax = options.expectimax;
+        search->adaptiveWidth = options.budgetMs > 0;
+    }
+
+    std::vector<GameResult> results(options.games);
+    auto start = std::chrono::steady_clock::now();
+
+    TaskGroup group;
+    auto play = [&](size_t i) {
+        results[i] = playGame(*searches[ThreadPool::currentLane()], options, options.seed + i);
+    };
+    pool.submitEach(group, options.games, play);
+    pool.wait(group);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Aggregate
+    std::vector<int> lines;
+    std::vector<uint64_t> scores;
+    std::array<size_t, TOP_OUT_CAUSE_COUNT> causes{};
+    std::array<uint64_t, 5> clears{};
+    uint64_t totalPieces = 0, tSpinClears = 0, perfectClears = 0;
+    for (const GameResult& result : results) {
+        lines.push_back(result.lines);
+        scores.push_back(result.score);
+        causes[result.topOut]++;
+        for (size_t n = 0; n < clears.size(); ++n) clears[n] += result.clears[n];
+        totalPieces += result.pieces;
+        tSpinClears += result.tSpinClears;
+        perfectClears += result.perfectClears;
+    }
+    std::sort(lines.begin(), lines.end());
+    std::sort(scores.begin(), scores.end());
+    double games = double(std::max<size_t>(options.games, 1));
+    double meanLines = std::accumulate(lines.begin(), lines.end(), 0.0) / games;
+    double meanScore = std::accumulate(scores.begin(), scores.end(), 0.0) / games;
+
+    std::printf("games %zu, threads %zu, depth %d, width %d%s, piece limit %d, seeds %llu..%llu\n",
+                options.games, pool.concurrency(), options.depth, options.width,
+                options.expectimax ? " + expectimax" : "", options.pieceLimit,
+                (unsigned long long)options.seed, (unsigned long long)(options.seed + options.games - 1));
+    std::printf("time       %.2f s, %llu pieces, %.0f pieces/s (%.0f per thread)\n",
+                seconds, (unsigned long long)totalPieces, totalPieces / seconds,
+                totalPieces / seconds / double(pool.concurrency()));
+    std::printf("lines      mean %.1f, median %d, min %d, max %d\n",
+                meanLines, percentile(lines, 0.5), lines.empty() ? 0 : lines.front(), lines.empty() ? 0 : lines.back());
+    std::printf("score      mean %.0f, min %llu, p10 %llu, p25 %llu, median %llu, p75 %llu, p90 %llu, max %llu\n",
+                meanScore, (unsigned long long)percentile(scores, 0.0), (unsigned long long)percentile(scores, 0.1),
+                (unsigned long long)percentile(scores, 0.25), (unsigned long long)percentile(scores, 0.5),
+                (unsigned long long)percentile(scores, 0.75), (unsigned long long)percentile(scores, 0.9),
+                (unsigned long long)percentile(scores, 1.0));
+    std::printf("clears     single %llu, double %llu, triple %llu, tetris %llu, t-spin %llu, perfect %llu\n",
+                (unsigned long long)clears[1], (unsigned long long)clears[2], (unsigned long long)clears[3],
+                (unsigned long long)clears[4], (unsigned long long)tSpinClears, (unsigned long long)perfectClears);
+    std::printf("outcomes  ");
+    for (size_t cause = 0; cause < causes.size(); ++cause) {
+        std::printf(" %s %zu%s", topOutNames[cause], causes[cause], cause + 1 < causes.size() ? "," : "\n");
+    }
+    return 0;
+}
@@ -0,0 +1,532 @@
+/********************************************************************************
+ * File: tests.cpp
+ * Author: ppkantorski
+ * Description:
+ *   Host checks for the Tetris Overlay's rules code:
+ *   - scoreLock() against the guideline tables: clear and T-spin values,
+ *     back-to-back, combo and perfect-clear bonuses, all scaled by level.
+ *   - classifyTSpin() on the three-corner rule: full, mini, too few
+ *     corners, no rotation, and the far kick that always makes it full.
+ *   - PerfectClearSolver against an unpruned search over the same moves
+ *     on fixed and generated boards; the solver's first move must also
+ *     leave a board the unpruned search can still clear.
+ *   - BeamSearch expectimax: restricting the pieces that can follow the
+ *     preview changes the expected value of the best line.
+ *   - Replay round trip of a game hidden mid-play: the pause the overlay
+ *     records on hide keeps playback in step across the hidden interval.
+ *   - IoWorker past its capacity: saves and urgent writes are all written,
+ *     only sheddable reports give way.
+ *   - ThreadPool with more tasks than a ring holds, some submitted from
+ *     inside tasks: all of them run, and they run side by side.
+ *
+ *   Usage: make && ./tests (exits non-zero if any check fails)
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <thread>
+
+#include "beam_search.hpp"
+#include "io_worker.hpp"
+#include "move_generator.hpp"
+#include "perfect_clear.hpp"
+#include "replay.hpp"
+#include "scoring.hpp"
+#include "thread_pool.hpp"
+#include "tspin.hpp"
+
+static int checks = 0;
+static int failures = 0;
+
+static void check(bool ok, const char* what, long long got, long long expected) {
+    checks++;
+    if (ok) return;
+    failures++;
+    std::printf("FAIL %s: got %lld, expected %lld\n", what, got, expected);
+}
+
+static void expectPoints(const LockScore& score, int expected, const char* what) {
+    check(score.points == expected, what, score.points, expected);
+}
+
+// ---------------------------------------------------------------------------
+// Scoring
+
+static void testClearTables() {
+    struct Row { TSpinType spin; int lines; int points; const char* what; };
+    static const Row rows[] = {
+        {TSPIN_NONE, 1, 100, "single"},           {TSPIN_NONE, 2, 300, "double"},
+        {TSPIN_NONE, 3, 500, "triple"},           {TSPIN_NONE, 4, 800, "tetris"},
+        {TSPIN_MINI, 0, 100, "mini T-spin"},      {TSPIN_MINI, 1, 200, "mini T-spin single"},
+        {TSPIN_MINI, 2, 400, "mini T-spin double"},
+        {TSPIN_FULL, 0, 400, "T-spin"},           {TSPIN_FULL, 1, 800, "T-spin single"},
+        {TSPIN_FULL, 2, 1200, "T-spin double"},   {TSPIN_FULL, 3, 1600, "T-spin triple"},
+    };
+    for (const Row& row : rows) {
+        for (int level : {1, 3}) {
+            ScoringState state;
+            expectPoints(scoreLock(state, row.lines, row.spin, false, level), row.points * level, row.what);
+        }
+    }
+}
+
+static void testBackToBack() {
+    // A non-clearing lock in between resets the combo but keeps the chain
+    ScoringState state;
+    expectPoints(scoreLock(state, 4, TSPIN_NONE, false, 1), 800, "first tetris");
+    scoreLock(state, 0, TSPIN_NONE, false, 1);
+    LockScore second = scoreLock(state, 4, TSPIN_NONE, false, 2);
+    expectPoints(second, 1200 * 2, "back-to-back tetris pays 1.5x");
+    check(second.backToBack, "back-to-back flag", second.backToBack, true);
+
+    // T-spin clears chain with Tetrises; a T-spin without lines keeps the chain alive but ends the combo
+    scoreLock(state, 0, TSPIN_FULL, false, 1);
+    expectPoints(scoreLock(state, 2, TSPIN_FULL, false, 1), 1200 * 3 / 2, "back-to-back T-spin double");
+
+    // Any other clear breaks it
+    scoreLock(state, 0, TSPIN_NONE, false, 1);
+    scoreLock(state, 1, TSPIN_NONE, false, 1);
+    scoreLock(state, 0, TSPIN_NONE, false, 1);
+    LockScore broken = scoreLock(state, 4, TSPIN_NONE, false, 1);
+    expectPoints(broken, 800, "tetris after a single is not back-to-back");
+    check(!broken.backToBack, "chain broken", broken.backToBack, false);
+}
+
+static void testCombo() {
+    // Each consecutive clearing lock adds 50 per combo step, times the level
+    ScoringState state;
+    expectPoints(scoreLock(state, 1, TSPIN_NONE, false, 3), 100 * 3, "combo 0");
+    expectPoints(scoreLock(state, 1, TSPIN_NONE, false, 3), (100 + 50) * 3, "combo 1");
+    expectPoints(scoreLock(state, 2, TSPIN_NONE, false, 3), (300 + 100) * 3, "combo 2");
+    check(state.combo == 2, "combo count", state.combo, 2);
+    expectPoints(scoreLock(state, 0, TSPIN_NONE, false, 3), 0, "lock without lines");
+    check(state.combo == -1, "combo reset", state.combo, -1);
+    expectPoints(scoreLock(state, 1, TSPIN_NONE, false, 3), 100 * 3, "combo restarts");
+}
+
+static void testPerfectClear() {
+    const int expected[5] = {0, 100 + 800, 300 + 1200, 500 + 1800, 800 + 2000};
+    for (int lines = 1; lines <= 4; ++lines) {
+        ScoringState state;
+        LockScore score = scoreLock(state, lines, TSPIN_NONE, true, 2);
+        expectPoints(score, expected[lines] * 2, "perfect clear bonus");
+        check(score.perfectClear, "perfect clear flag", score.perfectClear, true);
+    }
+
+    ScoringState state;
+    scoreLock(state, 4, TSPIN_NONE, false, 1);
+    scoreLock(state, 0, TSPIN_NONE, false, 1);
+    expectPoints(scoreLock(state, 4, TSPIN_NONE, true, 1), 1200 + 3200, "back-to-back tetris perfect clear");
+}
+
+// ---------------------------------------------------------------------------
+// T-spin corners
+
+// T pointing down (rotation 2) at piece position (3, 17): center (4, 18), corners (3|5, 17|19)
+static Bitboard tSlot(bool topLeft, bool topRight, bool bottomLeft, bool bottomRight) {
+    Bitboard board;
+    board.rows[19] = uint16_t(FULL_ROW & ~(1u << 4));
+    board.rows[18] = uint16_t(FULL_ROW & ~(7u << 3));
+    if (!bottomLeft) board.rows[19] &= uint16_t(~(1u << 3));
+    if (!bottomRight) board.rows[19] &= uint16_t(~(1u << 5));
+    if (topLeft) board.rows[17] |= 1u << 3;
+    if (topRight) board.rows[17] |= 1u << 5;
+    return board;
+}
+
+static void testTSpinCorners() {
+    const int x = 3, y = 17, rotation = 2;
+
+    // Three corners with both on the pointed side: full
+    uint8_t corners = tSpinCorners(tSlot(true, false, true, true), x, y);
+    check(classifyTSpin(T_PIECE, rotation, corners, true, false) == TSPIN_FULL, "three corners, both front", 0, 0);
+
+    // Three corners with one on the pointed side: mini, or full after the far kick
+    corners = tSpinCorners(tSlot(true, true, true, false), x, y);
+    check(classifyTSpin(T_PIECE, rotation, corners, true, false) == TSPIN_MINI, "three corners, one front", 0, 0);
+    check(classifyTSpin(T_PIECE, rotation, corners, true, true) == TSPIN_FULL, "far kick makes it full", 0, 0);
+
+    // Two corners: none
+    corners = tSpinCorners(tSlot(false, false, true, true), x, y);
+    check(classifyTSpin(T_PIECE, rotation, corners, true, false) == TSPIN_NONE, "two corners", 0, 0);
+
+    // Last action was not a rotation, or not a T: none
+    corners = tSpinCorners(tSlot(true, true, true, true), x, y);
+    check(classifyTSpin(T_PIECE, rotation, corners, false, false) == TSPIN_NONE, "moved last", 0, 0);
+    check(classifyTSpin(2, rotation, corners, true, false) == TSPIN_NONE, "not a T", 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Perfect clear solver against an unpruned search
+
+constexpr int HOLD_UNKNOWN = -2;
+
+struct Reference {
+    const SearchSituation* situation = nullptr;
+    std::array<int, SEARCH_PREVIEW_SIZE + 1> sequence{};
+    int sequenceLength = 0;
+
+    explicit Reference(const SearchSituation& s) : situation(&s) {
+        sequence[sequenceLength++] = s.current.type;
+        for (int8_t type : s.preview) {
+            if (type < 0) break;
+            sequence[sequenceLength++] = type;
+        }
+    }
+
+    static Tetrimino spawned(int type) {
+        Tetrimino piece(type);
+        placeAtSpawn(piece);
+        return piece;
+    }
+
+    // Every placement of piece that stays below height, then the same search from the result
+    bool tryPiece(const Bitboard& board, const Tetrimino& piece, int height, int nextIndex, int nextHold, int depth) const {
+        MoveGenerator generator;
+        generator.generate(board, piece, false);
+        for (const Placement& placement : generator) {
+            if (placement.y + pieceMask(piece.type, placement.rotation).top < BOARD_HEIGHT - height) continue;
+            Bitboard child = board;
+            child.place(piece.type, placement.rotation, placement.x, placement.y);
+            int cleared = child.clearLines();
+            if (search(child, height - cleared, std::min(nextIndex, sequenceLength), nextHold, true, depth + 1)) return true;
+        }
+        return false;
+    }
+
+    // Same moves and hold rules as PerfectClearSolver::search, without any pruning or memo
+    bool search(const Bitboard& board, int height, int index, int hold, bool canHold, int depth) const {
+        if (height == 0) return true;
+        if (depth >= PERFECT_CLEAR_MAX_PIECES) return false;
+        if (index < sequenceLength) {
+            Tetrimino piece = (depth == 0) ? situation->current : spawned(sequence[index]);
+            if (tryPiece(board, piece, height, index + 1, hold, depth)) return true;
+        }
+        if (canHold && hold >= 0) {
+            int next = (index < sequenceLength) ? sequence[index] : HOLD_UNKNOWN;
+            if (tryPiece(board, Tetrimino(hold), height, index + 1, next, depth)) return true;
+        }
+        if (canHold && hold == -1 && index + 1 < sequenceLength) {
+            if (tryPiece(board, spawned(sequence[index + 1]), height, index + 2, sequence[index], depth)) return true;
+        }
+        return false;
+    }
+
+    // Tries every height the queue has enough cells for; counting cells is the only shortcut taken
+    bool solvable() const {
+        int stack = 0;
+        for (int y = 0; y < BOARD_HEIGHT; ++y) {
+            if (situation->board.rows[y]) { stack = BOARD_HEIGHT - y; break; }
+        }
+        if (stack == 0) return false;
+
+        int filled = 0;
+        for (uint16_t row : situation->board.rows) filled += std::popcount(row);
+        int pieces = sequenceLength + (situation->stored >= 0 ? 1 : 0);
+
+        for (int height = stack; height <= PERFECT_CLEAR_MAX_HEIGHT; ++height) {
+            int empty = height * BOARD_WIDTH - filled;
+            if (empty % 4 != 0 || empty / 4 > pieces) continue;
+            if (search(situation->board, height, 0, situation->stored, situation->canHold, 0)) return true;
+        }
+        return false;
+    }
+
+    // Whether the rest of the queue still clears height rows after the solver's first move
+    bool continues(const SearchMove& first, int height) const {
+        Bitboard child = situation->board;
+        child.place(first.type, first.placement.rotation, first.placement.x, first.placement.y);
+        int cleared = child.clearLines();
+
+        int nextIndex = 1, nextHold = situation->stored;
+        if (first.useHold) {
+            if (situation->stored >= 0) {
+                nextHold = sequence[0];
+            } else {
+                nextIndex = 2;
+                nextHold = sequence[0];
+            }
+        }
+        return search(child, height - cleared, std::min(nextIndex, sequenceLength), nextHold, true, 1);
+    }
+};
+
+static void checkSolver(PerfectClearSolver& solver, const SearchSituation& situation, const char* what) {
+    PerfectClearResult result = solver.solve(situation, PerfectClearSolver::Clock::time_point::max(), [] { return false; });
+    Reference reference(situation);
+    bool expected = reference.solvable();
+    check(result.found == expected, what, result.found, expected);
+    if (result.found) {
+        check(reference.continues(result.first, result.height), "solver's first move leads to a clear", 0, 1);
+    }
+}
+
+static SearchSituation makeSituation(int current, int stored, std::array<int8_t, SEARCH_PREVIEW_SIZE> preview) {
+    SearchSituation situation;
+    situation.current = Tetrimino(current);
+    placeAtSpawn(situation.current);
+    situation.stored = stored;
+    situation.preview = preview;
+    return situation;
+}
+
+static void testPerfectClearFixed(PerfectClearSolver& solver) {
+    // I fills a four-wide gap in the bottom row
+    SearchSituation situation = makeSituation(0, -1, {{3, 3, 3}});
+    situation.board.rows[19] = uint16_t(FULL_ROW & ~0xFu);
+    checkSolver(solver, situation, "I into a single-row gap");
+
+    // Two O pieces fill a 4x2 hole; the first needs hold to reach the second O
+    situation = makeSituation(6, -1, {{3, 3, 1}});
+    situation.board.rows[18] = situation.board.rows[19] = uint16_t(FULL_ROW & ~(0xFu << 6));
+    checkSolver(solver, situation, "two O pieces via hold");
+
+    // Only S and Z pieces for an uneven eight-cell hole
+    situation = makeSituation(4, -1, {{6, 4, 6}});
+    situation.board.rows[19] = uint16_t(FULL_ROW & ~0xFu);
+    situation.board.rows[18] = uint16_t(FULL_ROW & ~0xFu);
+    situation.board.rows[19] |= 1u << 0;
+    situation.board.rows[18] &= uint16_t(~(1u << 4));
+    checkSolver(solver, situation, "S and Z only");
+
+    // Empty cells that are not a multiple of four: no clear
+    situation = makeSituation(0, 3, {{5, 2, 1}});
+    situation.board.rows[19] = uint16_t(FULL_ROW & ~0x7u);
+    checkSolver(solver, situation, "three empty cells");
+}
+
+// Holes carved by dropping random pieces into empty bottom rows. Half the queues start with
+// the carved pieces, so a good share of the boards has a clear to find.
+static void testPerfectClearGenerated(PerfectClearSolver& solver) {
+    PieceRandomizer rng;
+    rng.seed(12345);
+    MoveGenerator generator;
+    int solvable = 0;
+
+    for (int round = 0; round < 300; ++round) {
+        int height = 2 + int(rng.next() % 2);
+        int carved = 2 + int(rng.next() % 2);
+
+        Bitboard carving;
+        std::array<int, 3> carvedTypes{};
+        int carvedCount = 0;
+        for (int piece = 0; piece < carved; ++piece) {
+            int type = int(rng.next() % 7);
+            Tetrimino spawn(type);
+            placeAtSpawn(spawn);
+            generator.generate(carving, spawn, false);
+            if (generator.size() == 0) break;
+            const Placement& placement = generator[rng.next() % generator.size()];
+            if (placement.y + pieceMask(type, placement.rotation).top < BOARD_HEIGHT - height) continue;
+            carving.place(type, placement.rotation, placement.x, placement.y);
+            carvedTypes[carvedCount++] = type;
+        }
+
+        std::array<int, SEARCH_PREVIEW_SIZE + 1> queue;
+        for (auto& type : queue) type = int(rng.next() % 7);
+        if (rng.next() % 2 == 0) std::copy_n(carvedTypes.begin(), carvedCount, queue.begin());
+
+        std::array<int8_t, SEARCH_PREVIEW_SIZE> preview;
+        for (size_t i = 0; i < preview.size(); ++i) preview[i] = int8_t(queue[i + 1]);
+        int stored = int(rng.next() % 8) - 1;
+        SearchSituation situation = makeSituation(queue[0], stored, preview);
+        situation.canHold = rng.next() % 4 != 0;
+        for (int y = BOARD_HEIGHT - height; y < BOARD_HEIGHT; ++y) {
+            situation.board.rows[y] = uint16_t(FULL_ROW & ~carving.rows[y]);
+        }
+        if (situation.board.isEmpty()) continue;
+
+        solvable += Reference(situation).solvable();
+        checkSolver(solver, situation, "generated board");
+    }
+    std::printf("perfect clear: %d of 300 generated boards solvable\n", solvable);
+}
+
+// ---------------------------------------------------------------------------
+// Expectimax over the pieces after the preview
+
+static float expectedScore(BeamSearch& search, SearchSituation situation, uint8_t nextPieces) {
+    situation.nextPieces = nextPieces;
+    SearchMove move = search.run(situation, BeamSearch::Clock::time_point::max(), [] { return false; });
+    return move.score;
+}
+
+static void testExpectimaxPieceSet() {
+    // Four rows with a well on the right, and only O pieces in the queue to keep it open
+    SearchSituation situation = makeSituation(3, -1, {{3, 3, 3}});
+    situation.canHold = false;
+    for (int y = BOARD_HEIGHT - 4; y < BOARD_HEIGHT; ++y) situation.board.rows[y] = uint16_t(FULL_ROW & ~(1u << 9));
+
+    BeamSearch search;
+    search.adaptiveWidth = false;
+    float any = expectedScore(search, situation, ALL_PIECE_TYPES);
+    float onlyI = expectedScore(search, situation, 1u << 0);
+    float onlySZ = expectedScore(search, situation, (1u << 4) | (1u << 6));
+    check(onlyI > any, "an I after the queue is worth more than any piece", int(onlyI), int(any));
+    check(onlySZ < any, "only S or Z after the queue is worth less", int(onlySZ), int(any));
+    check(expectedScore(search, situation, ALL_PIECE_TYPES) == any, "full set again after restricted ones", 0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Replay across a hidden overlay
+
+// Frame-clock model of the overlay's game: gravity and lock delay only advance
+// while unpaused, and Plus toggles the pause, as in TetrisGui::stepFrame
+struct ClockedGame {
+    bool paused = false;
+    uint64_t runningMs = 0;
+    int drops = 0;
+
+    void step(const ReplayFrame& frame) {
+        if (!paused) {
+            runningMs += frame.deltaMs;
+            drops = int(runningMs / 500);
+        }
+        if (frame.down & REPLAY_PLUS) paused = !paused;
+    }
+};
+
+static void testReplayHide() {
+    ReplayRecorder recorder;
+    recorder.start(7);
+    ClockedGame live;
+    auto run = [&](uint32_t deltaMs, uint8_t held, uint8_t down) {
+        recorder.record(deltaMs, held, down);
+        live.step({deltaMs, held, down});
+    };
+
+    for (int frame = 0; frame < 120; ++frame) run(16, frame % 30 < 10 ? REPLAY_LEFT : 0, 0);
+    // TetrisGui::pauseForHide: the pause goes through a recorded frame
+    run(16, 0, REPLAY_PLUS);
+    // Shown again a minute later; the first frame carries the hidden interval, then Plus resumes
+    run(60000, 0, 0);
+    run(16, REPLAY_PLUS, REPLAY_PLUS);
+    for (int frame = 0; frame < 120; ++frame) run(16, 0, 0);
+    recorder.stop();
+
+    std::vector<uint8_t> data = recorder.serialize(uint32_t(live.drops));
+    const char* path = "replay_hide_test.rpl";
+    std::FILE* file = std::fopen(path, "wb");
+    std::fwrite(data.data(), 1, data.size(), file);
+    std::fclose(file);
+
+    ReplayReader reader;
+    bool loaded = reader.loadFromFile(path);
+    std::remove(path);
+    check(loaded, "hidden-game replay loads", loaded, true);
+
+    ClockedGame replayed;
+    ReplayFrame frame;
+    while (reader.next(frame)) replayed.step(frame);
+    check(reader.getFramesRead() == recorder.getFrameCount(), "every frame played back", reader.getFramesRead(), recorder.getFrameCount());
+    check(replayed.runningMs == live.runningMs, "hidden interval not simulated", replayed.runningMs, live.runningMs);
+    check(uint32_t(replayed.drops) == reader.getStateHash(), "playback ends in step", replayed.drops, reader.getStateHash());
+    check(!replayed.paused, "resumed after showing", replayed.paused, false);
+}
+
+// ---------------------------------------------------------------------------
+// I/O worker overflow
+
+static bool fileExists(const char* path) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (file) std::fclose(file);
+    return file != nullptr;
+}
+
+static void testIoWorkerOverflow() {
+    const char* paths[] = {"io_test_busy", "io_test_save", "io_test_report1", "io_test_report2", "io_test_replay", "io_test_csv"};
+    auto contents = [] { return std::vector<uint8_t>{'x'}; };
+
+    // Hold the worker on a first write so the rest queue up behind it
+    std::atomic<bool> started{false}, release{false};
+    IoWorker worker(2, std::chrono::milliseconds(5000));
+    worker.submit(paths[0], [&] {
+        started = true;
+        while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return std::vector<uint8_t>{'x'};
+    }, true);
+    while (!started) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // An autosave, then more than the queue holds, as finishRecording queues right after it
+    worker.submit(paths[1], contents, false);
+    worker.submit(paths[2], contents, true, std::chrono::milliseconds(0), true);
+    worker.submit(paths[3], contents, true, std::chrono::milliseconds(0), true);
+    worker.submit(paths[4], contents, true);
+    worker.submit(paths[5], contents, true);
+    check(worker.droppedCount() == 2, "sheddable reports give way", worker.droppedCount(), 2);
+
+    release = true;
+    worker.shutdown(std::chrono::milliseconds(5000));
+    const bool expected[] = {true, true, false, false, true, true};
+    for (size_t i = 0; i < std::size(paths); ++i) {
+        bool written = fileExists(paths[i]);
+        check(written == expected[i], paths[i], written, expected[i]);
+        std::remove(paths[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Thread pool
+
+struct PoolLoad {
+    ThreadPool* pool;
+    TaskGroup* group;
+    size_t parents;
+    std::atomic<size_t> ran{0};
+    std::atomic<size_t> onSubmitter{0};
+};
+
+static void runPoolTask(void* context, size_t index) {
+    PoolLoad& load = *static_cast<PoolLoad*>(context);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    load.ran.fetch_add(1, std::memory_order_relaxed);
+    if (ThreadPool::currentLane() == 0) load.onSubmitter.fetch_add(1, std::memory_order_relaxed);
+    // Half of the tasks queue a child on their own thread's ring, which may be full too
+    if (index < load.parents && index % 2 == 0) load.pool->submit(*load.group, &runPoolTask, &load, load.parents + index);
+}
+
+static void testThreadPool() {
+    const size_t lanes = 4, tasks = 1000;
+    ThreadPool pool(lanes);
+    TaskGroup group;
+    PoolLoad load{&pool, &group, tasks};
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < tasks; ++i) pool.submit(group, &runPoolTask, &load, i);
+    pool.wait(group);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t total = tasks + tasks / 2;
+    check(load.ran == total, "every pool task runs", load.ran, total);
+    // Sleeping tasks overlap even on one core; run one at a time they would take total milliseconds
+    check(seconds < total * 0.001 / 2, "pool tasks run side by side (ms)", int(seconds * 1000), total / 2);
+    check(load.onSubmitter < total / 2, "submitting thread runs only its share", load.onSubmitter, total / 2);
+}
+
+int main() {
+    testClearTables();
+    testBackToBack();
+    testCombo();
+    testPerfectClear();
+    testTSpinCorners();
+
+    PerfectClearSolver solver;
+    solver.maxNodes = SIZE_MAX;
+    testPerfectClearFixed(solver);
+    testPerfectClearGenerated(solver);
+
+    testExpectimaxPieceSet();
+    testReplayHide();
+    testIoWorkerOverflow();
+    testThreadPool();
+
+    std::printf("%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
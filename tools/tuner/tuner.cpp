@@ -0,0 +1,339 @@
+/********************************************************************************
+ * File: tuner.cpp
+ * Author: ppkantorski
+ * Description:
+ *   Genetic tuner for the Tetris Overlay's evaluator weights. Each
+ *   generation plays every weight vector of the population through the same
+ *   batch of seeded HeadlessGame self-play games, spread over the thread
+ *   pool, and breeds the next generation from the mean scores: the best
+ *   vectors carry over unchanged, the rest come from tournament selection,
+ *   blend crossover and relative Gaussian mutation.
+ *
+ *   A pool task plays one vector's whole batch on its thread's own search,
+ *   so the search arena and transposition table stay allocated across games
+ *   and the table is only cleared when the task's weights differ from the
+ *   previous task's. After every generation the population is checkpointed
+ *   (--resume continues from it) and the generation's best vector is written
+ *   as a weights file that the overlay loads from
+ *   sdmc:/config/tetris/weights.bin.
+ *
+ *   Usage: tuner [--population N] [--generations N] [--games N] [--pieces N]
+ *                [--threads N] [--seed N] [--width N] [--depth N] [--expectimax]
+ *                [--sigma X] [--checkpoint PATH] [--output PATH] [--resume]
+ *
+ *  Licensed under GPLv2
+ *  Copyright (c) 2024 ppkantorski
+ ********************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "beam_search.hpp"
+#include "headless_game.hpp"
+#include "io_worker.hpp"
+#include "thread_pool.hpp"
+#include "weights_file.hpp"
+
+constexpr uint32_t CHECKPOINT_MAGIC = 0x504F5054; // "TPOP"
+constexpr uint8_t CHECKPOINT_VERSION = 1;
+
+struct Options {
+    size_t population = 24;
+    int generations = 50;       // Generations to run, counting those of a resumed checkpoint
+    size_t games = 8;           // Games per vector and generation
+    int pieceLimit = 500;       // A game that survives this long counts as finished
+    size_t threads = ThreadPool::defaultConcurrency();
+    uint64_t seed = 1;
+    int width = 8;
+    int depth = 2;
+    bool expectimax = false;
+    float sigma = 0.3f;         // Mutation step relative to each weight's magnitude
+    size_t elites = 2;
+    std::string checkpoint = "tuner.pop";
+    std::string output = "weights.bin";
+    bool resume = false;
+};
+
+struct Individual {
+    WeightVector weights{};
+    double fitness = 0.0;
+};
+
+// xorshift64* with Box-Muller normals; the state is checkpointed with the population
+struct TunerRandom {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    double uniform() { return double(next() >> 11) * 0x1.0p-53; }
+    size_t below(size_t bound) { return size_t(uniform() * double(bound)) % bound; }
+
+    double normal() {
+        double u = std::max(uniform(), 1e-12);
+        return std::sqrt(-2.0 * std::log(u)) * std::cos(6.283185307179586 * uniform());
+    }
+};
+
+struct Tuner {
+    uint32_t generation = 0;
+    TunerRandom random;
+    std::vector<Individual> population;
+};
+
+// One thread's game state and search, reused by every task it runs
+struct Lane {
+    BeamSearch search{BeamSearch::HOST_TABLE_SLOTS};
+    HeadlessGame game;
+};
+
+static void printUsage() {
+    std::printf("usage: tuner [--population N] [--generations N] [--games N] [--pieces N]\n"
+                "             [--threads N] [--seed N] [--width N] [--depth N] [--expectimax]\n"
+                "             [--sigma X] [--checkpoint PATH] [--output PATH] [--resume]\n");
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--expectimax") == 0) {
+            options.expectimax = true;
+            continue;
+        }
+        if (std::strcmp(arg, "--resume") == 0) {
+            options.resume = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+
+        const char* text = argv[++i];
+        if (std::strcmp(arg, "--checkpoint") == 0) { options.checkpoint = text; continue; }
+        if (std::strcmp(arg, "--output") == 0) { options.output = text; continue; }
+        if (std::strcmp(arg, "--sigma") == 0) { options.sigma = float(std::atof(text)); continue; }
+
+        long long value = std::atoll(text);
+        if (value < 0) return false;
+        if (std::strcmp(arg, "--population") == 0) options.population = std::max<size_t>(2, size_t(value));
+        else if (std::strcmp(arg, "--generations") == 0) options.generations = int(value);
+        else if (std::strcmp(arg, "--games") == 0) options.games = std::max<size_t>(1, size_t(value));
+        else if (std::strcmp(arg, "--pieces") == 0) options.pieceLimit = int(value);
+        else if (std::strcmp(arg, "--threads") == 0) options.threads = std::max<size_t>(1, size_t(value));
+        else if (std::strcmp(arg, "--seed") == 0) options.seed = uint64_t(value);
+        else if (std::strcmp(arg, "--width") == 0) options.width = std::max(1, int(value));
+        else if (std::strcmp(arg, "--depth") == 0) options.depth = std::max(1, int(value));
+        else return false;
+    }
+    options.elites = std::min(options.elites, options.population - 1);
+    return options.sigma > 0.0f;
+}
+
+// Checkpoint layout (little-endian): "TPOP", u8 version, u8 weight count, u16 reserved,
+// u32 generation, u64 random state, u32 population size, then per individual the
+// weights as float32 and the fitness as float64, and a u32 CRC-32 trailer
+static std::vector<uint8_t> encodeCheckpoint(const Tuner& tuner) {
+    std::vector<uint8_t> out;
+    putLE(out, CHECKPOINT_MAGIC, 4);
+    putLE(out, CHECKPOINT_VERSION, 1);
+    putLE(out, EVAL_WEIGHT_COUNT, 1);
+    putLE(out, 0, 2);
+    putLE(out, tuner.generation, 4);
+    putLE(out, tuner.random.state, 8);
+    putLE(out, tuner.population.size(), 4);
+    for (const Individual& individual : tuner.population) {
+        for (float value : individual.weights) putLE(out, std::bit_cast<uint32_t>(value), 4);
+        putLE(out, std::bit_cast<uint64_t>(individual.fitness), 8);
+    }
+    putLE(out, crc32(out.data(), out.size()), 4);
+    return out;
+}
+
+static bool decodeCheckpoint(const std::vector<uint8_t>& data, Tuner& tuner) {
+    constexpr size_t headerSize = 24;
+    constexpr size_t individualSize = EVAL_WEIGHT_COUNT * 4 + 8;
+    if (data.size() < headerSize + 4) return false;
+    if (getLE(data.data(), 4) != CHECKPOINT_MAGIC || data[4] != CHECKPOINT_VERSION) return false;
+    if (data[5] != EVAL_WEIGHT_COUNT) return false;
+
+    size_t count = getLE(data.data() + 20, 4);
+    if (count < 2 || data.size() != headerSize + count * individualSize + 4) return false;
+    if (getLE(data.data() + data.size() - 4, 4) != crc32(data.data(), data.size() - 4)) return false;
+
+    tuner.generation = uint32_t(getLE(data.data() + 8, 4));
+    tuner.random.state = getLE(data.data() + 12, 8);
+    tuner.population.assign(count, Individual());
+    const uint8_t* in = data.data() + headerSize;
+    for (Individual& individual : tuner.population) {
+        for (float& value : individual.weights) {
+            value = std::bit_cast<float>(uint32_t(getLE(in, 4)));
+            in += 4;
+        }
+        individual.fitness = std::bit_cast<double>(getLE(in, 8));
+        in += 8;
+    }
+    return true;
+}
+
+// The defaults plus mutated copies of them
+static void seedPopulation(Tuner& tuner, const Options& options) {
+    tuner.random.state = options.seed * 0x9E3779B97F4A7C15ULL | 1;
+    tuner.population.assign(options.population, Individual());
+    WeightVector defaults = toWeightVector(EvalWeights());
+    for (size_t i = 0; i < tuner.population.size(); ++i) {
+        WeightVector& weights = tuner.population[i].weights;
+        weights = defaults;
+        if (i == 0) continue;
+        for (float& value : weights) {
+            value += float(tuner.random.normal()) * options.sigma * std::max(std::fabs(value), 0.1f);
+        }
+    }
+}
+
+static double playBatch(Lane& lane, const WeightVector& weights, const Options& options,
+                        uint64_t firstSeed, uint64_t& pieces) {
+    lane.search.weights = fromWeightVector(weights);
+    double total = 0.0;
+    for (size_t g = 0; g < options.games; ++g) {
+        HeadlessGame& game = lane.game;
+        game.reset(firstSeed + g);
+        while (!game.over() && game.pieces < options.pieceLimit) {
+            game.play(lane.search.run(game.situation(), BeamSearch::Clock::time_point::max(), [] { return false; }));
+        }
+        total += double(game.score);
+        pieces += uint64_t(game.pieces);
+    }
+    return total / double(options.games);
+}
+
+static const Individual& tournament(Tuner& tuner, size_t size) {
+    const Individual* best = &tuner.population[tuner.random.below(tuner.population.size())];
+    for (size_t i = 1; i < size; ++i) {
+        const Individual& rival = tuner.population[tuner.random.below(tuner.population.size())];
+        if (rival.fitness > best->fitness) best = &rival;
+    }
+    return *best;
+}
+
+// Population sorted best-first; elites carry over, the rest are bred from tournaments
+static void breed(Tuner& tuner, const Options& options) {
+    std::vector<Individual> next(tuner.population.begin(), tuner.population.begin() + options.elites);
+    while (next.size() < tuner.population.size()) {
+        const Individual& a = tournament(tuner, 3);
+        const Individual& b = tournament(tuner, 3);
+        Individual child;
+        for (size_t i = 0; i < EVAL_WEIGHT_COUNT; ++i) {
+            // Blend crossover reaching a little past both parents
+            double mix = tuner.random.uniform() * 1.5 - 0.25;
+            double value = a.weights[i] + mix * (b.weights[i] - a.weights[i]);
+            if (tuner.random.uniform() < 0.3) {
+                value += tuner.random.normal() * options.sigma * std::max(std::fabs(value), 0.1);
+            }
+            child.weights[i] = float(value);
+        }
+        next.push_back(child);
+    }
+    tuner.population = std::move(next);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    Tuner tuner;
+    if (options.resume) {
+        std::vector<uint8_t> data;
+        auto isValid = [&](const std::vector<uint8_t>& contents) { return decodeCheckpoint(contents, tuner); };
+        if (!readFileWithFallback(options.checkpoint, data, isValid)) {
+            std::printf("no valid checkpoint at %s\n", options.checkpoint.c_str());
+            return 1;
+        }
+        options.elites = std::min(options.elites, tuner.population.size() - 1);
+        std::printf("resumed generation %u, population %zu\n", tuner.generation, tuner.population.size());
+    } else {
+        seedPopulation(tuner, options);
+    }
+
+    ThreadPool pool(options.threads);
+    std::vector<std::unique_ptr<Lane>> lanes(pool.concurrency());
+    for (auto& lane : lanes) {
+        lane = std::make_unique<Lane>();
+        lane->search.beamWidth = options.width;
+        lane->search.maxBeamWidth = std::max(options.width, lane->search.maxBeamWidth);
+        lane->search.maxDepth = options.depth;
+        lane->search.expectimax = options.expectimax;
+        lane->search.adaptiveWidth = false;
+    }
+
+    std::printf("population %zu, games %zu, piece limit %d, depth %d, width %d%s, threads %zu\n",
+                tuner.population.size(), options.games, options.pieceLimit, options.depth, options.width,
+                options.expectimax ? " + expectimax" : "", pool.concurrency());
+
+    for (; int(tuner.generation) < options.generations; ++tuner.generation) {
+        auto start = std::chrono::steady_clock::now();
+
+        // Every vector plays the same seeds, new ones each generation
+        uint64_t firstSeed = options.seed + uint64_t(tuner.generation) * options.games;
+        std::vector<uint64_t> pieces(tuner.population.size(), 0);
+        TaskGroup group;
+        auto evaluate = [&](size_t i) {
+            Individual& individual = tuner.population[i];
+            individual.fitness = playBatch(*lanes[ThreadPool::currentLane()], individual.weights,
+                                           options, firstSeed, pieces[i]);
+        };
+        pool.submitEach(group, tuner.population.size(), evaluate);
+        pool.wait(group);
+
+        std::stable_sort(tuner.population.begin(), tuner.population.end(),
+                         [](const Individual& a, const Individual& b) { return a.fitness > b.fitness; });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t totalPieces = std::accumulate(pieces.begin(), pieces.end(), uint64_t(0));
+        double mean = 0.0;
+        for (const Individual& individual : tuner.population) mean += individual.fitness;
+        mean /= double(tuner.population.size());
+        std::printf("generation %u: best %.0f, mean %.0f, median %.0f, %.1f s, %.0f pieces/s\n",
+                    tuner.generation + 1, tuner.population.front().fitness, mean,
+                    tuner.population[tuner.population.size() / 2].fitness, seconds, totalPieces / seconds);
+        std::fflush(stdout);
+
+        if (!writeFileAtomically(options.output, encodeWeights(fromWeightVector(tuner.population.front().weights)))) {
+            std::printf("could not write %s\n", options.output.c_str());
+        }
+
+        breed(tuner, options);
+        Tuner saved = tuner;
+        saved.generation++;
+        if (!writeFileAtomically(options.checkpoint, encodeCheckpoint(saved))) {
+            std::printf("could not write %s\n", options.checkpoint.c_str());
+        }
+    }
+
+    EvalWeights best;
+    std::vector<uint8_t> data;
+    auto isValid = [&](const std::vector<uint8_t>& contents) {
+        return decodeWeights(contents.data(), contents.size(), best);
+    };
+    if (readFileWithFallback(options.output, data, isValid)) {
+        WeightVector values = toWeightVector(best);
+        std::printf("best weights (%s):\n", options.output.c_str());
+        for (size_t i = 0; i < values.size(); ++i) {
+            std::printf("  %-18s %8.3f\n", EVAL_WEIGHT_NAMES[i], values[i]);
+        }
+    }
+    return 0;
+}